@@ -0,0 +1,219 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _LRU_CACHE_H_
+#define _LRU_CACHE_H_
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+
+namespace AutoKeyDeck
+{
+	/// <summary>
+	/// Counters for an LruCache
+	/// </summary>
+	struct LruCacheStats
+	{
+		std::size_t hits = 0;
+		std::size_t misses = 0;
+		std::size_t evictions = 0;	// Removed to make room
+		std::size_t expirations = 0;	// Removed when found past their time to live
+		std::size_t size = 0;
+		std::size_t weight = 0;	// Total weight of entries held
+		std::size_t capacity = 0;
+	};
+
+	/// <summary>
+	/// Template class mapping keys to values, holding entries up to a fixed total weight
+	/// (by default each entry weighs 1, so capacity is an entry count).
+	/// When full, least recently used entries are evicted. Entries may also expire 
+	/// a fixed time after they are set.
+	/// Not safe to be called by multiple threads.
+	/// </summary>
+	/// <typeparam name="T_Key">Key type, hashable</typeparam>
+	/// <typeparam name="T_Value">Value type</typeparam>
+	/// <typeparam name="T_Clock">Clock for expiry</typeparam>
+	template <typename T_Key, typename T_Value, class T_Clock = std::chrono::steady_clock>
+	class LruCache
+	{
+	private:
+
+		struct Entry
+		{
+			T_Key key;
+			T_Value value;
+			std::size_t weight;
+			typename T_Clock::time_point expires;
+		};
+
+		typedef std::list<Entry> T_Entries;
+
+		//-------------------------------
+		// Properties
+		//-------------------------------
+
+		// Most recently used first
+		T_Entries mEntries;
+		std::unordered_map<T_Key, typename T_Entries::iterator> mIndex;
+
+		// Max total weight
+		std::size_t mCapacity;
+		std::size_t mWeight;
+
+		// Zero for no expiry
+		typename T_Clock::duration mTimeToLive;
+
+		LruCacheStats mStats;
+
+		//-------------------------------
+		// Private methods
+		//-------------------------------
+
+		void Erase(typename std::unordered_map<T_Key, typename T_Entries::iterator>::iterator indexIt)
+		{
+			mWeight -= indexIt->second->weight;
+			mEntries.erase(indexIt->second);
+			mIndex.erase(indexIt);
+		}
+
+	public:
+
+		/// <summary>
+		/// Constructor
+		/// </summary>
+		/// <param name="capacity">Max total weight of entries held. At least 1.</param>
+		/// <param name="timeToLive">Time after setting an entry that it expires, or zero for never</param>
+		explicit LruCache(std::size_t capacity, typename T_Clock::duration timeToLive = T_Clock::duration::zero()) :
+			mCapacity(capacity > 0 ? capacity : 1), mWeight(0), mTimeToLive(timeToLive) {}
+
+		/// <summary>
+		/// Find the value for a key, marking it most recently used
+		/// </summary>
+		/// <param name="key">Key to find</param>
+		/// <returns>Pointer to the value, valid until the cache is next changed, or nullptr if not found or expired</returns>
+		T_Value* Get(const T_Key& key)
+		{
+			auto indexIt = mIndex.find(key);
+
+			if (indexIt == mIndex.end())
+			{
+				++mStats.misses;
+				return nullptr;
+			}
+
+			if (mTimeToLive != T_Clock::duration::zero() && indexIt->second->expires <= T_Clock::now())
+			{
+				Erase(indexIt);
+				++mStats.expirations;
+				++mStats.misses;
+				return nullptr;
+			}
+
+			mEntries.splice(mEntries.begin(), mEntries, indexIt->second);
+			++mStats.hits;
+
+			return &mEntries.front().value;
+		}
+
+		/// <summary>
+		/// Set the value for a key, marking it most recently used, and evicting 
+		/// least recently used entries until it fits
+		/// </summary>
+		/// <param name="key">Key to set</param>
+		/// <param name="value">Value to store</param>
+		/// <param name="weight">Weight of the entry</param>
+		/// <returns>False if the entry weighs more than the capacity, in which case any existing entry for the key is removed</returns>
+		template<typename T_V = T_Value>
+		bool Set(const T_Key& key, T_V&& value, std::size_t weight = 1)
+		{
+			auto indexIt = mIndex.find(key);
+
+			if (indexIt != mIndex.end()) Erase(indexIt);
+
+			if (weight > mCapacity) return false;
+
+			while (mWeight + weight > mCapacity)
+			{
+				mWeight -= mEntries.back().weight;
+				mIndex.erase(mEntries.back().key);
+				mEntries.pop_back();
+				++mStats.evictions;
+			}
+
+			typename T_Clock::time_point expires{};
+			if (mTimeToLive != T_Clock::duration::zero()) expires = T_Clock::now() + mTimeToLive;
+
+			mEntries.push_front(Entry{ key, std::forward<T_V>(value), weight, expires });
+			mIndex[key] = mEntries.begin();
+			mWeight += weight;
+
+			return true;
+		}
+
+		/// <summary>
+		/// Remove the entry for a key
+		/// </summary>
+		/// <param name="key">Key to remove</param>
+		/// <returns>True if an entry was removed</returns>
+		bool Remove(const T_Key& key)
+		{
+			auto indexIt = mIndex.find(key);
+
+			if (indexIt == mIndex.end()) return false;
+
+			Erase(indexIt);
+			return true;
+		}
+
+		/// <summary>
+		/// Remove all entries. Counters are kept.
+		/// </summary>
+		void Clear()
+		{
+			mIndex.clear();
+			mEntries.clear();
+			mWeight = 0;
+		}
+
+		/// <summary>
+		/// Get number of entries held, including any expired but not yet removed
+		/// </summary>
+		/// <returns>Entry count</returns>
+		std::size_t Size() const
+		{
+			return mEntries.size();
+		}
+
+		/// <summary>
+		/// Get the counters
+		/// </summary>
+		/// <returns>Stats snapshot</returns>
+		LruCacheStats GetStats() const
+		{
+			LruCacheStats stats = mStats;
+			stats.size = mEntries.size();
+			stats.weight = mWeight;
+			stats.capacity = mCapacity;
+			return stats;
+		}
+	};
+};
+#endif
@@ -0,0 +1,65 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+-- Compare allocation-heavy task throughput with and without the worker's pooled allocator
+
+package.cpath = package.cpath..";".."LuaWorker.dll;"
+
+require('LuaWorker')
+
+local benchmark = [[
+	local t0 = os.clock()
+	local keep = {}
+	for i = 1,2000000 do
+		local t = {i, i + 1, x = i}
+		keep[i % 1000 + 1] = t
+	end
+	local tables = os.clock() - t0
+
+	t0 = os.clock()
+	for i = 1,1000000 do
+		keep[i % 1000 + 1] = "item" .. i
+	end
+	local strings = os.clock() - t0
+
+	return string.format("%.3f %.3f", tables, strings)
+]]
+
+local function RunBenchmark(pooled)
+	local worker = LuaWorker.Create(100, {PoolAllocator = pooled})
+	worker:Start()
+
+	local result = worker:DoString(benchmark):Await(60000)
+	local stats = worker:MemoryStats()
+	worker:Stop()
+
+	local tables, strings = string.match(result or "", "(%S+) (%S+)")
+	print(string.format("%-6s  2M tables: %6.3fs   1M strings: %6.3fs   peak: %8d bytes   pooled: %d/%d", 
+		pooled and "Pool" or "System", tonumber(tables) or -1, tonumber(strings) or -1, 
+		stats.PeakBytesInUse, stats.PooledAllocations, stats.Allocations))
+
+	return tonumber(tables), tonumber(strings)
+end
+
+local systemTables, systemStrings = RunBenchmark(false)
+local poolTables, poolStrings = RunBenchmark(true)
+
+if systemTables and poolTables and poolTables > 0 and poolStrings > 0 then
+	print(string.format("Pool allocator: tables %.2fx, strings %.2fx the speed of the system allocator", 
+		systemTables / poolTables, systemStrings / poolStrings))
+end
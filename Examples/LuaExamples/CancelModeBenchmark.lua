@@ -0,0 +1,63 @@
+--[[**************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+]]--**************************************************************************/
+
+-- Compare call-heavy task throughput for each cancellation mode
+
+package.cpath = package.cpath..";".."LuaWorker.dll;"
+
+require('LuaWorker')
+
+local benchmark = [[
+	local function f(x) return x + 1 end
+
+	local t0 = os.clock()
+	local n = 0
+	for i = 1,20000000 do
+		n = f(n)
+	end
+	local calls = os.clock() - t0
+
+	t0 = os.clock()
+	n = 0
+	for i = 1,20000000 do
+		n = n + 1
+	end
+	local loop = os.clock() - t0
+
+	return string.format("%.3f %.3f", calls, loop)
+]]
+
+local function RunBenchmark(modeName)
+	local worker = LuaWorker.Create(100, {CancelMode = LuaWorker.CancelMode[modeName]})
+	worker:Start()
+
+	local result = worker:DoString(benchmark):Await(60000)
+	worker:Stop()
+
+	local calls, loop = string.match(result or "", "(%S+) (%S+)")
+	print(string.format("%-5s  20M Lua calls: %6.3fs   20M loop iterations: %6.3fs", modeName, tonumber(calls) or -1, tonumber(loop) or -1))
+
+	return tonumber(calls)
+end
+
+local hookCalls = RunBenchmark("Hook")
+local lazyCalls = RunBenchmark("Lazy")
+
+if hookCalls and lazyCalls and lazyCalls > 0 then
+	print(string.format("Call overhead removed by Lazy mode: %.1fx faster", hookCalls / lazyCalls))
+end
@@ -0,0 +1,57 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+-- Compare start-up time and memory of worker states opening all standard libraries, or only some
+
+package.cpath = package.cpath..";".."LuaWorker.dll;"
+
+require('LuaWorker')
+
+local count = 200
+
+local function RunBenchmark(name, options)
+	local workers = {}
+	local ready = {}
+
+	local t0 = os.clock()
+	for i = 1,count do
+		workers[i] = LuaWorker.Create(100, options)
+		local _, task = workers[i]:Start()
+		ready[i] = task
+	end
+	LuaWorker.AwaitAll(ready, 60000)
+	local elapsed = os.clock() - t0
+
+	local bytes = 0
+	for i = 1,count do
+		bytes = bytes + workers[i]:MemoryStats().BytesInUse
+	end
+
+	for i = 1,count do
+		workers[i]:Stop()
+	end
+
+	print(string.format("%-22s  %d states ready in %6.3fs   %7d bytes per state", name, count, elapsed, math.floor(bytes / count)))
+
+	return elapsed, bytes / count
+end
+
+local allTime, allBytes = RunBenchmark("All libraries", {})
+local someTime, someBytes = RunBenchmark("string, table, math", {Libs = {"string", "table", "math"}})
+
+print(string.format("Saved per state: %.0f bytes, %.3fms", allBytes - someBytes, 1000 * (allTime - someTime) / count))
@@ -0,0 +1,605 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#include "CacheLuaInterface.h"
+
+using namespace LuaWorker;
+
+//-------------------------------
+// Static Lua helper methods
+//-------------------------------
+CacheLuaInterface::LocalCache* CacheLuaInterface::l_ToCache(lua_State* pL)
+{
+	// Upvalue is the userdata holding the cache
+	return (LocalCache*)lua_touserdata(pL, lua_upvalueindex(1));
+}
+
+bool CacheLuaInterface::l_IsCacheable(lua_State* pL, int index)
+{
+	switch (lua_type(pL, index))
+	{
+	case LUA_TBOOLEAN:
+	case LUA_TSTRING:
+		return true;
+	case LUA_TNUMBER:
+	{
+		lua_Number n = lua_tonumber(pL, index);
+		return n == n;
+	}
+	default:
+		return false;
+	}
+}
+
+CacheLuaInterface::CacheItem CacheLuaInterface::l_ToItem(lua_State* pL, int index)
+{
+	switch (lua_type(pL, index))
+	{
+	case LUA_TBOOLEAN:
+		return CacheItem(std::in_place_type<bool>, lua_toboolean(pL, index) != 0);
+	case LUA_TNUMBER:
+		return CacheItem(std::in_place_type<lua_Number>, lua_tonumber(pL, index));
+	default:
+	{
+		size_t len = 0;
+		const char* str = lua_tolstring(pL, index, &len);
+		return CacheItem(std::in_place_type<std::string>, str, len);
+	}
+	}
+}
+
+void CacheLuaInterface::l_PushItem(lua_State* pL, const CacheItem& item)
+{
+	if (const bool* b = std::get_if<bool>(&item)) lua_pushboolean(pL, *b);
+	else if (const lua_Number* n = std::get_if<lua_Number>(&item)) lua_pushnumber(pL, *n);
+	else
+	{
+		const std::string& str = std::get<std::string>(item);
+		lua_pushlstring(pL, str.c_str(), str.length());
+	}
+}
+
+std::shared_ptr<SharedCache> CacheLuaInterface::l_ToSharedCache(lua_State* pL)
+{
+	// Upvalue is the userdata holding a shared_ptr to the cache
+	std::shared_ptr<SharedCache>* ppCache = (std::shared_ptr<SharedCache>*)lua_touserdata(pL, lua_upvalueindex(1));
+
+	return ppCache == nullptr ? nullptr : *ppCache;
+}
+
+bool CacheLuaInterface::l_Serialize(lua_State* pL, int index, std::string& out, int depth)
+{
+	if (index < 0) index = lua_gettop(pL) + index + 1;
+
+	switch (lua_type(pL, index))
+	{
+	case LUA_TBOOLEAN:
+		out += 'b';
+		out += lua_toboolean(pL, index) ? '1' : '0';
+		return true;
+	case LUA_TNUMBER:
+	{
+		lua_Number n = lua_tonumber(pL, index);
+		out += 'n';
+		out.append((const char*)&n, sizeof(n));
+		return true;
+	}
+	case LUA_TSTRING:
+	{
+		size_t len = 0;
+		const char* str = lua_tolstring(pL, index, &len);
+		out += 's';
+		out.append((const char*)&len, sizeof(len));
+		out.append(str, len);
+		return true;
+	}
+	case LUA_TTABLE:
+		if (depth >= cMaxSerializeDepth || !lua_checkstack(pL, 2)) return false;
+
+		out += 't';
+		lua_pushnil(pL);
+		while (lua_next(pL, index) != 0)
+		{
+			if (!l_Serialize(pL, -2, out, depth + 1) || !l_Serialize(pL, -1, out, depth + 1))
+			{
+				lua_pop(pL, 2);
+				return false;
+			}
+			lua_pop(pL, 1);
+		}
+		out += 'e';
+		return true;
+	default:
+		return false;
+	}
+}
+
+void CacheLuaInterface::l_PushSerialized(lua_State* pL, const std::string& data, std::size_t& pos)
+{
+	switch (data[pos++])
+	{
+	case 'b':
+		lua_pushboolean(pL, data[pos++] == '1');
+		break;
+	case 'n':
+	{
+		lua_Number n;
+		std::memcpy(&n, data.data() + pos, sizeof(n));
+		pos += sizeof(n);
+		lua_pushnumber(pL, n);
+		break;
+	}
+	case 's':
+	{
+		size_t len;
+		std::memcpy(&len, data.data() + pos, sizeof(len));
+		pos += sizeof(len);
+		lua_pushlstring(pL, data.data() + pos, len);
+		pos += len;
+		break;
+	}
+	case 't':
+		lua_checkstack(pL, 3);
+		lua_newtable(pL);
+		while (data[pos] != 'e')
+		{
+			l_PushSerialized(pL, data, pos);
+			l_PushSerialized(pL, data, pos);
+			lua_rawset(pL, -3);
+		}
+		++pos;
+		break;
+	default:
+		lua_pushnil(pL);
+	}
+}
+
+//-------------------------------
+// Public Static Lua-callable methods
+//-------------------------------
+int CacheLuaInterface::l_InLuaWorker_Cache(lua_State* pL)
+{
+	if (!lua_isnumber(pL, 1) || lua_tointeger(pL, 1) < 1)
+	{
+		luaL_error(pL, "Cache capacity required!");
+		return 0;
+	}
+
+	size_t capacity = (size_t)lua_tointeger(pL, 1);
+
+	long ttlMillis = 0;
+	if (lua_isnumber(pL, 2)) ttlMillis = std::max(0L, (long)lua_tointeger(pL, 2));
+
+	lua_createtable(pL, 0, 5);
+
+	// Every method holds the userdata, so the cache lives while any of them can be called
+	void* pMem = lua_newuserdata(pL, sizeof(LocalCache));
+	new (pMem) LocalCache(capacity, std::chrono::milliseconds(ttlMillis));
+		lua_createtable(pL, 0, 1);
+			lua_pushcfunction(pL, l_Cache_Delete);
+		lua_setfield(pL, -2, "__gc");
+	lua_setmetatable(pL, -2);
+
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_Cache_Get, 1);
+	lua_setfield(pL, -3, "Get");
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_Cache_Set, 1);
+	lua_setfield(pL, -3, "Set");
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_Cache_Remove, 1);
+	lua_setfield(pL, -3, "Remove");
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_Cache_Clear, 1);
+	lua_setfield(pL, -3, "Clear");
+		lua_pushcclosure(pL, l_Cache_Stats, 1);
+	lua_setfield(pL, -2, "Stats");
+
+	return 1;
+}
+
+int CacheLuaInterface::l_Cache_Delete(lua_State* pL)
+{
+	LocalCache* pCache = (LocalCache*)lua_touserdata(pL, 1);
+
+	if (pCache != nullptr) pCache->~LocalCache();
+
+	return 0;
+}
+
+int CacheLuaInterface::l_Cache_Get(lua_State* pL)
+{
+	LocalCache* pCache = l_ToCache(pL);
+
+	if (pCache != nullptr && l_IsCacheable(pL, 2))
+	{
+		CacheItem* pValue = pCache->Get(l_ToItem(pL, 2));
+
+		if (pValue != nullptr)
+		{
+			l_PushItem(pL, *pValue);
+			return 1;
+		}
+	}
+
+	lua_pushnil(pL);
+	return 1;
+}
+
+int CacheLuaInterface::l_Cache_Set(lua_State* pL)
+{
+	LocalCache* pCache = l_ToCache(pL);
+
+	if (pCache == nullptr) return 0;
+
+	if (!l_IsCacheable(pL, 2))
+	{
+		luaL_error(pL, "Cache key must be a string, number or boolean!");
+		return 0;
+	}
+
+	if (lua_isnoneornil(pL, 3))
+	{
+		pCache->Remove(l_ToItem(pL, 2));
+		return 0;
+	}
+
+	if (!l_IsCacheable(pL, 3))
+	{
+		luaL_error(pL, "Cache value must be a string, number or boolean!");
+		return 0;
+	}
+
+	pCache->Set(l_ToItem(pL, 2), l_ToItem(pL, 3));
+
+	return 0;
+}
+
+int CacheLuaInterface::l_Cache_Remove(lua_State* pL)
+{
+	LocalCache* pCache = l_ToCache(pL);
+
+	lua_pushboolean(pL, pCache != nullptr && l_IsCacheable(pL, 2) && pCache->Remove(l_ToItem(pL, 2)));
+	return 1;
+}
+
+int CacheLuaInterface::l_Cache_Clear(lua_State* pL)
+{
+	LocalCache* pCache = l_ToCache(pL);
+
+	if (pCache != nullptr) pCache->Clear();
+
+	return 0;
+}
+
+int CacheLuaInterface::l_Cache_Stats(lua_State* pL)
+{
+	LocalCache* pCache = l_ToCache(pL);
+
+	if (pCache == nullptr) return 0;
+
+	AutoKeyDeck::LruCacheStats stats = pCache->GetStats();
+
+	lua_createtable(pL, 0, 6);
+		lua_pushinteger(pL, (lua_Integer)stats.hits);
+	lua_setfield(pL, -2, "hits");
+		lua_pushinteger(pL, (lua_Integer)stats.misses);
+	lua_setfield(pL, -2, "misses");
+		lua_pushinteger(pL, (lua_Integer)stats.evictions);
+	lua_setfield(pL, -2, "evictions");
+		lua_pushinteger(pL, (lua_Integer)stats.expirations);
+	lua_setfield(pL, -2, "expirations");
+		lua_pushinteger(pL, (lua_Integer)stats.size);
+	lua_setfield(pL, -2, "size");
+		lua_pushinteger(pL, (lua_Integer)stats.capacity);
+	lua_setfield(pL, -2, "capacity");
+
+	return 1;
+}
+
+int CacheLuaInterface::l_LuaWorker_SharedCache(lua_State* pL)
+{
+	if (!lua_isstring(pL, 1))
+	{
+		luaL_error(pL, "Shared cache name required!");
+		return 0;
+	}
+
+	size_t maxBytes = SharedCache::cDefaultMaxBytes;
+	if (lua_isnumber(pL, 2)) maxBytes = (size_t)std::max((lua_Integer)1, lua_tointeger(pL, 2));
+
+	size_t shards = SharedCache::cDefaultShards;
+	if (lua_isnumber(pL, 3)) shards = (size_t)std::max((lua_Integer)1, lua_tointeger(pL, 3));
+
+	std::shared_ptr<SharedCache> pCache = SharedCache::Open(lua_tostring(pL, 1), maxBytes, shards);
+
+	lua_createtable(pL, 0, 5);
+
+	void* pMem = lua_newuserdata(pL, sizeof(std::shared_ptr<SharedCache>));
+	new (pMem) std::shared_ptr<SharedCache>(pCache);
+		lua_createtable(pL, 0, 1);
+			lua_pushcfunction(pL, l_SharedCache_Delete);
+		lua_setfield(pL, -2, "__gc");
+	lua_setmetatable(pL, -2);
+
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_SharedCache_Get, 1);
+	lua_setfield(pL, -3, "Get");
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_SharedCache_Set, 1);
+	lua_setfield(pL, -3, "Set");
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_SharedCache_Remove, 1);
+	lua_setfield(pL, -3, "Remove");
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_SharedCache_Clear, 1);
+	lua_setfield(pL, -3, "Clear");
+		lua_pushcclosure(pL, l_SharedCache_Stats, 1);
+	lua_setfield(pL, -2, "Stats");
+
+	return 1;
+}
+
+int CacheLuaInterface::l_SharedCache_Delete(lua_State* pL)
+{
+	std::shared_ptr<SharedCache>* ppCache = (std::shared_ptr<SharedCache>*)lua_touserdata(pL, 1);
+
+	if (ppCache != nullptr) ppCache->~shared_ptr();
+
+	return 0;
+}
+
+int CacheLuaInterface::l_SharedCache_Get(lua_State* pL)
+{
+	std::shared_ptr<SharedCache> pCache = l_ToSharedCache(pL);
+
+	std::string key, value;
+
+	if (pCache != nullptr && l_IsCacheable(pL, 2) && l_Serialize(pL, 2, key) && pCache->Get(key, value))
+	{
+		std::size_t pos = 0;
+		l_PushSerialized(pL, value, pos);
+		return 1;
+	}
+
+	lua_pushnil(pL);
+	return 1;
+}
+
+int CacheLuaInterface::l_SharedCache_Set(lua_State* pL)
+{
+	const char* error = nullptr;
+	bool stored = false;
+
+	{
+		std::shared_ptr<SharedCache> pCache = l_ToSharedCache(pL);
+		std::string key, value;
+
+		if (pCache == nullptr) return 0;
+
+		if (!l_IsCacheable(pL, 2)) error = "Shared cache key must be a string, number or boolean!";
+		else if (lua_isnoneornil(pL, 3))
+		{
+			l_Serialize(pL, 2, key);
+			pCache->Remove(key);
+			stored = true;
+		}
+		else if (!l_Serialize(pL, 3, value)) error = "Shared cache value must be a string, number, boolean or table of these!";
+		else
+		{
+			l_Serialize(pL, 2, key);
+			stored = pCache->Set(key, value);
+		}
+	}
+
+	// No C++ objects live here, in case luaL_error does not unwind them
+	if (error != nullptr)
+	{
+		luaL_error(pL, error);
+		return 0;
+	}
+
+	lua_pushboolean(pL, stored);
+	return 1;
+}
+
+int CacheLuaInterface::l_SharedCache_Remove(lua_State* pL)
+{
+	std::shared_ptr<SharedCache> pCache = l_ToSharedCache(pL);
+
+	std::string key;
+
+	lua_pushboolean(pL, pCache != nullptr && l_IsCacheable(pL, 2) && l_Serialize(pL, 2, key) && pCache->Remove(key));
+	return 1;
+}
+
+int CacheLuaInterface::l_SharedCache_Clear(lua_State* pL)
+{
+	std::shared_ptr<SharedCache> pCache = l_ToSharedCache(pL);
+
+	if (pCache != nullptr) pCache->Clear();
+
+	return 0;
+}
+
+int CacheLuaInterface::l_SharedCache_Stats(lua_State* pL)
+{
+	std::shared_ptr<SharedCache> pCache = l_ToSharedCache(pL);
+
+	if (pCache == nullptr) return 0;
+
+	std::vector<SharedCache::ShardStats> stats = pCache->GetStats();
+	SharedCache::ShardStats total;
+
+	lua_createtable(pL, 0, 9);
+	lua_createtable(pL, (int)stats.size(), 0);
+
+	for (size_t i = 0; i < stats.size(); ++i)
+	{
+		const SharedCache::ShardStats& shard = stats[i];
+
+		total.cache.hits += shard.cache.hits;
+		total.cache.misses += shard.cache.misses;
+		total.cache.evictions += shard.cache.evictions;
+		total.cache.size += shard.cache.size;
+		total.cache.weight += shard.cache.weight;
+		total.cache.capacity += shard.cache.capacity;
+		total.locks += shard.locks;
+		total.contended += shard.contended;
+
+		lua_createtable(pL, 0, 8);
+			lua_pushinteger(pL, (lua_Integer)shard.cache.hits);
+		lua_setfield(pL, -2, "hits");
+			lua_pushinteger(pL, (lua_Integer)shard.cache.misses);
+		lua_setfield(pL, -2, "misses");
+			lua_pushinteger(pL, (lua_Integer)shard.cache.evictions);
+		lua_setfield(pL, -2, "evictions");
+			lua_pushinteger(pL, (lua_Integer)shard.cache.size);
+		lua_setfield(pL, -2, "size");
+			lua_pushinteger(pL, (lua_Integer)shard.cache.weight);
+		lua_setfield(pL, -2, "bytes");
+			lua_pushinteger(pL, (lua_Integer)shard.cache.capacity);
+		lua_setfield(pL, -2, "capacity");
+			lua_pushinteger(pL, (lua_Integer)shard.locks);
+		lua_setfield(pL, -2, "locks");
+			lua_pushinteger(pL, (lua_Integer)shard.contended);
+		lua_setfield(pL, -2, "contended");
+		lua_rawseti(pL, -2, (int)i + 1);
+	}
+	lua_setfield(pL, -2, "shards");
+
+		lua_pushinteger(pL, (lua_Integer)total.cache.hits);
+	lua_setfield(pL, -2, "hits");
+		lua_pushinteger(pL, (lua_Integer)total.cache.misses);
+	lua_setfield(pL, -2, "misses");
+		lua_pushinteger(pL, (lua_Integer)total.cache.evictions);
+	lua_setfield(pL, -2, "evictions");
+		lua_pushinteger(pL, (lua_Integer)total.cache.size);
+	lua_setfield(pL, -2, "size");
+		lua_pushinteger(pL, (lua_Integer)total.cache.weight);
+	lua_setfield(pL, -2, "bytes");
+		lua_pushinteger(pL, (lua_Integer)total.cache.capacity);
+	lua_setfield(pL, -2, "capacity");
+		lua_pushinteger(pL, (lua_Integer)total.locks);
+	lua_setfield(pL, -2, "locks");
+		lua_pushinteger(pL, (lua_Integer)total.contended);
+	lua_setfield(pL, -2, "contended");
+
+	return 1;
+}
+
+int CacheLuaInterface::l_LuaWorker_Snapshot(lua_State* pL)
+{
+	if (!lua_isstring(pL, 1))
+	{
+		luaL_error(pL, "Snapshot store name required!");
+		return 0;
+	}
+
+	std::shared_ptr<SnapshotStore> pStore = SnapshotStore::Open(lua_tostring(pL, 1));
+
+	lua_createtable(pL, 0, 3);
+
+	void* pMem = lua_newuserdata(pL, sizeof(SnapshotHandle));
+	new (pMem) SnapshotHandle{ pStore };
+		lua_createtable(pL, 0, 1);
+			lua_pushcfunction(pL, l_Snapshot_Delete);
+		lua_setfield(pL, -2, "__gc");
+	lua_setmetatable(pL, -2);
+
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_Snapshot_Get, 1);
+	lua_setfield(pL, -3, "Get");
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_Snapshot_Publish, 1);
+	lua_setfield(pL, -3, "Publish");
+		lua_pushcclosure(pL, l_Snapshot_Version, 1);
+	lua_setfield(pL, -2, "Version");
+
+	return 1;
+}
+
+int CacheLuaInterface::l_Snapshot_Delete(lua_State* pL)
+{
+	SnapshotHandle* pHandle = (SnapshotHandle*)lua_touserdata(pL, 1);
+
+	if (pHandle != nullptr) pHandle->~SnapshotHandle();
+
+	return 0;
+}
+
+int CacheLuaInterface::l_Snapshot_Get(lua_State* pL)
+{
+	SnapshotHandle* pHandle = (SnapshotHandle*)lua_touserdata(pL, lua_upvalueindex(1));
+
+	if (pHandle == nullptr) return 0;
+
+	// A fresh copy on every read, so a caller changing it cannot affect later reads
+	std::shared_ptr<const SnapshotStore::Snapshot> pSnapshot = pHandle->store->GetCurrent();
+
+	if (pSnapshot == nullptr)
+	{
+		lua_pushnil(pL);
+		lua_pushnumber(pL, 0);
+		return 2;
+	}
+
+	std::size_t pos = 0;
+	l_PushSerialized(pL, pSnapshot->data, pos);
+	lua_pushnumber(pL, (lua_Number)pSnapshot->version);
+	return 2;
+}
+
+int CacheLuaInterface::l_Snapshot_Publish(lua_State* pL)
+{
+	SnapshotHandle* pHandle = (SnapshotHandle*)lua_touserdata(pL, lua_upvalueindex(1));
+
+	if (pHandle == nullptr) return 0;
+
+	std::uint64_t version = 0;
+
+	{
+		std::string data;
+		if (l_Serialize(pL, 2, data)) version = pHandle->store->Publish(std::move(data));
+	}
+
+	// No C++ objects live here, in case luaL_error does not unwind them
+	if (version == 0)
+	{
+		luaL_error(pL, "Snapshot value must be a string, number, boolean or table of these!");
+		return 0;
+	}
+
+	lua_pushnumber(pL, (lua_Number)version);
+	return 1;
+}
+
+int CacheLuaInterface::l_Snapshot_Version(lua_State* pL)
+{
+	SnapshotHandle* pHandle = (SnapshotHandle*)lua_touserdata(pL, lua_upvalueindex(1));
+
+	if (pHandle == nullptr) return 0;
+
+	lua_pushnumber(pL, (lua_Number)pHandle->store->GetVersion());
+	return 1;
+}
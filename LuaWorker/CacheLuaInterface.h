@@ -0,0 +1,322 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _CACHE_LUA_INTERFACE_H_
+#define _CACHE_LUA_INTERFACE_H_
+#pragma once
+
+#include <string>
+#include <variant>
+
+#include "LruCache.h"
+#include "SharedCache.h"
+#include "SnapshotStore.h"
+
+extern "C" {
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+}
+
+namespace LuaWorker
+{
+	/// <summary>
+	/// Lua interface for bounded caches held in C++ rather than in lua tables:
+	/// local caches owned by one lua state, and shared caches and snapshot stores reachable from every state
+	/// </summary>
+	class CacheLuaInterface
+	{
+	private:
+
+		// Copy of a cacheable lua value (boolean, number or string)
+		typedef std::variant<bool, lua_Number, std::string> CacheItem;
+
+		typedef AutoKeyDeck::LruCache<CacheItem, CacheItem> LocalCache;
+
+		// Max nesting of tables stored in a shared cache
+		static const int cMaxSerializeDepth = 32;
+
+		// Userdata held by snapshot store handles
+		struct SnapshotHandle
+		{
+			std::shared_ptr<SnapshotStore> store;
+		};
+
+		//-------------------------------
+		// Static Lua helper methods
+		//-------------------------------
+
+		/// <summary>
+		/// Get the cache referenced by the calling closure
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Cache, or nullptr if already deleted</returns>
+		static LocalCache* l_ToCache(lua_State* pL);
+
+		/// <summary>
+		/// Check whether the value at the given stack index can be stored in a cache
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="index">Stack index of the value</param>
+		/// <returns>True for booleans, strings and numbers other than NaN</returns>
+		static bool l_IsCacheable(lua_State* pL, int index);
+
+		/// <summary>
+		/// Copy a cacheable value from the lua stack
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="index">Stack index of the value</param>
+		/// <returns>Copy of the value</returns>
+		static CacheItem l_ToItem(lua_State* pL, int index);
+
+		/// <summary>
+		/// Push a cached value to the lua stack
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="item">Value to push</param>
+		static void l_PushItem(lua_State* pL, const CacheItem& item);
+
+		/// <summary>
+		/// Get the shared cache referenced by the calling closure
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Shared cache</returns>
+		static std::shared_ptr<SharedCache> l_ToSharedCache(lua_State* pL);
+
+		/// <summary>
+		/// Append the value at the given stack index to a string, such that it can be 
+		/// recreated in any lua state by l_PushSerialized. Tables are copied deeply.
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="index">Stack index of the value</param>
+		/// <param name="out">String to append to</param>
+		/// <param name="depth">Current table nesting</param>
+		/// <returns>False if the value (or a table entry) is not a boolean, number, string or table, or tables nest too deeply</returns>
+		static bool l_Serialize(lua_State* pL, int index, std::string& out, int depth = 0);
+
+		/// <summary>
+		/// Push a value written by l_Serialize
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="data">Serialized values</param>
+		/// <param name="pos">Position of the value in data, advanced past it</param>
+		static void l_PushSerialized(lua_State* pL, const std::string& data, std::size_t& pos);
+
+	public:
+
+		//-------------------------------
+		// Static Lua-callable methods
+		//-------------------------------
+
+		/// <summary>
+		/// Create a cache holding up to a given number of entries, 
+		/// evicting the least recently used entry when full. Entries
+		/// expire after the optional time to live. Keys and values
+		/// may be strings, numbers or booleans.
+		/// 
+		/// Lua syntax:
+		///		local cache = InLuaWorker.Cache(capacity, ttlMillis)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_InLuaWorker_Cache(lua_State* pL);
+
+		/// <summary>
+		/// Destroy the cache. Called by lua gc.
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Cache_Delete(lua_State* pL);
+
+		/// <summary>
+		/// Return the cached value for a key, or nil if absent or expired
+		/// 
+		/// Lua syntax:
+		///		local value = cache:Get(key)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Cache_Get(lua_State* pL);
+
+		/// <summary>
+		/// Store a value for a key. Setting nil removes the key.
+		/// 
+		/// Lua syntax:
+		///		cache:Set(key, value)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Cache_Set(lua_State* pL);
+
+		/// <summary>
+		/// Remove a key. Returns true if it was present.
+		/// 
+		/// Lua syntax:
+		///		local removed = cache:Remove(key)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Cache_Remove(lua_State* pL);
+
+		/// <summary>
+		/// Remove all entries
+		/// 
+		/// Lua syntax:
+		///		cache:Clear()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Cache_Clear(lua_State* pL);
+
+		/// <summary>
+		/// Return a table of counters: hits, misses, evictions, 
+		/// expirations, size and capacity
+		/// 
+		/// Lua syntax:
+		///		local stats = cache:Stats()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Cache_Stats(lua_State* pL);
+
+		/// <summary>
+		/// Get the process-wide shared cache with the given name, creating it
+		/// if needed with the given byte budget and number of shards (each locked separately).
+		/// Keys may be strings, numbers or booleans. Values may also be tables,
+		/// which are copied.
+		/// 
+		/// Lua syntax:
+		///		local cache = LuaWorker.SharedCache(name, maxBytes, shards)
+		///		local cache = InLuaWorker.SharedCache(name, maxBytes, shards)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_LuaWorker_SharedCache(lua_State* pL);
+
+		/// <summary>
+		/// Release the handle's reference to the shared cache. Called by lua gc.
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_SharedCache_Delete(lua_State* pL);
+
+		/// <summary>
+		/// Return a copy of the value for a key, or nil if absent
+		/// 
+		/// Lua syntax:
+		///		local value = cache:Get(key)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_SharedCache_Get(lua_State* pL);
+
+		/// <summary>
+		/// Store a copy of a value for a key. Setting nil removes the key.
+		/// Returns false if the value is too large to store.
+		/// 
+		/// Lua syntax:
+		///		local stored = cache:Set(key, value)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_SharedCache_Set(lua_State* pL);
+
+		/// <summary>
+		/// Remove a key. Returns true if it was present.
+		/// 
+		/// Lua syntax:
+		///		local removed = cache:Remove(key)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_SharedCache_Remove(lua_State* pL);
+
+		/// <summary>
+		/// Remove all entries
+		/// 
+		/// Lua syntax:
+		///		cache:Clear()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_SharedCache_Clear(lua_State* pL);
+
+		/// <summary>
+		/// Return a table of counters summed over shards (hits, misses, evictions, 
+		/// size, bytes, capacity, locks, contended), with the counters of each shard 
+		/// in the array field shards
+		/// 
+		/// Lua syntax:
+		///		local stats = cache:Stats()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_SharedCache_Stats(lua_State* pL);
+
+		/// <summary>
+		/// Get the process-wide snapshot store with the given name, creating it if needed.
+		/// 
+		/// Lua syntax:
+		///		local config = LuaWorker.Snapshot(name)
+		///		local config = InLuaWorker.Snapshot(name)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_LuaWorker_Snapshot(lua_State* pL);
+
+		/// <summary>
+		/// Release the handle's reference to the snapshot store. Called by lua gc.
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Snapshot_Delete(lua_State* pL);
+
+		/// <summary>
+		/// Return a copy of the current value, and its version. 
+		/// Each call builds a new copy, so changes to it are private to the caller. 
+		/// Compare Version() to skip reading an unchanged value.
+		/// 
+		/// Lua syntax:
+		///		local value, version = config:Get()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Snapshot_Get(lua_State* pL);
+
+		/// <summary>
+		/// Publish a copy of a value as the current version. Returns the new version number.
+		/// 
+		/// Lua syntax:
+		///		local version = config:Publish(value)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Snapshot_Publish(lua_State* pL);
+
+		/// <summary>
+		/// Return the current version number, 0 if nothing is published
+		/// 
+		/// Lua syntax:
+		///		local version = config:Version()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Snapshot_Version(lua_State* pL);
+	};
+};
+#endif
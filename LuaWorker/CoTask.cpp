@@ -22,6 +22,7 @@
 #include<exception>
 
 #include "CoTask.h"
+#include "LuaAllocator.h"
 
 extern "C" {
 #include "lua.h"
@@ -29,9 +30,17 @@ extern "C" {
 #include "lualib.h"
 }
 
+using namespace std::chrono_literals;
+using std::chrono::system_clock;
+
 using namespace LuaWorker;
 
-CoTask::CoTask(const std::string& funcString, const std::vector<std::string>& argStrings)
+CoTask::CoTask(const std::string& funcString, const std::vector<std::string>& argStrings) 
+	: mInputCapacity(cDefaultInputCapacity), 
+	mInputClosed(false), 
+	mAwaitingInput(false),
+	mPreempted(false),
+	mResuming(false)
 {
 	mExecString = "return " + funcString;
 
@@ -41,6 +50,25 @@ CoTask::CoTask(const std::string& funcString, const std::vector<std::string>& ar
 	}
 }
 
+//-------------------------------
+// Private methods
+//-------------------------------
+
+CoTaskInput CoTask::PopInput(std::string& out)
+{
+	{
+		std::unique_lock<std::mutex> lock(mInputMtx);
+
+		if (mInput.empty()) return mInputClosed ? CoTaskInput::Closed : CoTaskInput::Empty;
+
+		out = std::move(mInput.front());
+		mInput.pop_front();
+	}
+
+	mInputCv.notify_all(); // Space for writers
+	return CoTaskInput::Chunk;
+}
+
 //-------------------------------
 // Protected methods
 //-------------------------------
@@ -83,7 +111,9 @@ std::string CoTask::DoExec(lua_State* pL)
 /// <param name="pL">Lua state</param>
 std::string CoTask::DoResume(lua_State* pL, int argC)
 {
+	mResuming = true;
 	int execResult = lua_resume(pL, argC);
+	mResuming = false;
 
 	if (execResult != 0 && execResult != LUA_YIELD)
 	{
@@ -98,7 +128,8 @@ std::string CoTask::DoResume(lua_State* pL, int argC)
 
 	std::string ret = "";
 
-	if (lua_type(pL, -1) == LUA_TSTRING) ret = lua_tostring(pL, -1);
+	// A preempted thread yielded from a hook, so the top of its stack belongs to the running function
+	if (!mPreempted && lua_type(pL, -1) == LUA_TSTRING) ret = lua_tostring(pL, -1);
 
 	lua_settop(pL, 0);
 
@@ -114,10 +145,15 @@ void CoTask::Exec(lua_State* pL)
 {
 	if (pL == nullptr || !TrySetRunning()) return;
 
+	mAwaitingInput = false;
+	mPreempted = false;
+
 	std::string res = this->DoExec(pL);
 
-	SetResult(res, lua_status(pL) == LUA_YIELD);
+	if ((mAwaitingInput || mPreempted) && lua_status(pL) == LUA_YIELD) SetSuspended();
+	else SetResult(res, lua_status(pL) == LUA_YIELD);
 
+	if (lua_status(pL) != LUA_YIELD) mInputCv.notify_all(); // Release blocked writers
 }
 
 //------
@@ -125,7 +161,125 @@ void CoTask::Resume(lua_State* pL)
 {
 	if (pL == nullptr || lua_status(pL) != LUA_YIELD || !TrySetRunning(TaskStatus::Suspended)) return;
 
-	std::string res = this->DoResume(pL, 0);
-	SetResult(res , lua_status(pL) == LUA_YIELD);
+	int argC = 0;
+
+	if (mAwaitingInput)
+	{
+		// Pass next chunk as the return value of the suspended Read
+		std::string chunk;
+		if (PopInput(chunk) == CoTaskInput::Chunk)
+		{
+			LuaAllocator::UnlimitedScope unlimited(pL); // Not a protected call, so must not fail
+			lua_pushlstring(pL, chunk.data(), chunk.size());
+			argC = 1;
+		}
+		mAwaitingInput = false;
+	}
+
+	mPreempted = false;
+
+	std::string res = this->DoResume(pL, argC);
 
+	if ((mAwaitingInput || mPreempted) && lua_status(pL) == LUA_YIELD) SetSuspended();
+	else SetResult(res , lua_status(pL) == LUA_YIELD);
+
+	if (lua_status(pL) != LUA_YIELD) mInputCv.notify_all(); // Release blocked writers
+}
+
+//------
+void CoTask::Cancel()
+{
+	Task::Cancel();
+
+	mInputCv.notify_all();
+}
+
+//------
+bool CoTask::Write(const std::string& chunk, unsigned int waitForMillis)
+{
+	system_clock::time_point waitTill = system_clock::now() + (waitForMillis * 1ms);
+	std::weak_ptr<Wakeable> listenerRef;
+
+	{
+		std::unique_lock<std::mutex> lock(mInputMtx);
+
+		while (true)
+		{
+			if (mInputClosed || IsFinal(GetStatus())) return false;
+
+			if (mInput.size() < mInputCapacity) break;
+
+			if (mInputCv.wait_until(lock, waitTill) == std::cv_status::timeout
+				&& mInput.size() >= mInputCapacity) return false;
+		}
+
+		mInput.push_back(chunk);
+		listenerRef = mInputListener;
+	}
+
+	std::shared_ptr<Wakeable> listener = listenerRef.lock();
+	if (listener != nullptr) listener->Wake();
+
+	return true;
+}
+
+//------
+void CoTask::CloseInput()
+{
+	std::weak_ptr<Wakeable> listenerRef;
+
+	{
+		std::unique_lock<std::mutex> lock(mInputMtx);
+		mInputClosed = true;
+		listenerRef = mInputListener;
+	}
+
+	mInputCv.notify_all(); // Release blocked writers
+
+	std::shared_ptr<Wakeable> listener = listenerRef.lock();
+	if (listener != nullptr) listener->Wake();
+}
+
+//------
+CoTaskInput CoTask::Read(std::string& out)
+{
+	CoTaskInput res = PopInput(out);
+
+	mAwaitingInput = (res == CoTaskInput::Empty);
+
+	return res;
+}
+
+//------
+void CoTask::Preempt()
+{
+	mPreempted = true;
+}
+
+//------
+bool CoTask::IsResuming()
+{
+	return mResuming;
+}
+
+//------
+bool CoTask::IsAwaitingInput()
+{
+	return mAwaitingInput;
+}
+
+//------
+bool CoTask::IsInputReady()
+{
+	if (IsFinal(GetStatus())) return true;
+
+	std::unique_lock<std::mutex> lock(mInputMtx);
+	return mInputClosed || !mInput.empty();
+}
+
+//------
+void CoTask::SetInputListener(const std::weak_ptr<Wakeable>& listener)
+{
+	std::unique_lock<std::mutex> lock(mInputMtx);
+	mInputListener = listener;
 }
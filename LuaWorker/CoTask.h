@@ -25,8 +25,12 @@
 //#include <thread>
 #include <vector>
 #include <string>
+#include <deque>
+#include <mutex>
+#include <memory>
 
 #include "Task.h"
+#include "Wakeable.h"
 
 extern "C" {
 #include "lua.h"
@@ -37,6 +41,12 @@ extern "C" {
 
 namespace LuaWorker
 {
+	enum class CoTaskInput {
+		Chunk,	// Chunk read
+		Empty,	// No chunk available yet
+		Closed	// No more chunks will be written
+	};
+
 	/// <summary>
 	/// Task to start a coroutine on the worker thread
 	/// </summary>
@@ -45,6 +55,31 @@ namespace LuaWorker
 	private:
 		std::string mExecString;
 
+		std::deque<std::string> mInput;
+		std::size_t mInputCapacity;
+		bool mInputClosed;
+
+		std::mutex mInputMtx;
+		std::condition_variable mInputCv;
+
+		std::weak_ptr<Wakeable> mInputListener;
+
+		//Access in worker thread only
+		bool mAwaitingInput;
+
+		//Access in worker thread only
+		bool mPreempted;
+
+		//Access in worker thread only. True while inside lua_resume
+		bool mResuming;
+
+		/// <summary>
+		/// Pop the next input chunk, if available
+		/// </summary>
+		/// <param name="out">Receives the chunk read</param>
+		/// <returns>Result of the read</returns>
+		CoTaskInput PopInput(std::string& out);
+
 		/// <summary>
 		/// Make initial resume call to start the coroutine
 		/// Called on the worker lua state.
@@ -62,6 +97,11 @@ namespace LuaWorker
 		std::string DoResume(lua_State* pL, int argC);
 	public:
 
+		/// <summary>
+		/// Default maximum number of unread input chunks
+		/// </summary>
+		static const std::size_t cDefaultInputCapacity = 16;
+
 		/// <summary>
 		/// Constructor
 		/// </summary>
@@ -82,6 +122,70 @@ namespace LuaWorker
 		/// <param name="pL">Lua state</param>
 		void Resume(lua_State* pL);
 
+		/// <summary>
+		/// Permanently cancel execution, releasing any blocked writers
+		/// </summary>
+		void Cancel();
+
+		/// <summary>
+		/// Push an input chunk for the coroutine to read, blocking while the input buffer is full.
+		/// Can be called from any thread
+		/// </summary>
+		/// <param name="chunk">Chunk to push</param>
+		/// <param name="waitForMillis">Max time to wait for space in the buffer</param>
+		/// <returns>True if the chunk was queued</returns>
+		bool Write(const std::string& chunk, unsigned int waitForMillis);
+
+		/// <summary>
+		/// Signal that no more input will be written. Reads return end of input once the buffer is empty.
+		/// Can be called from any thread
+		/// </summary>
+		void CloseInput();
+
+		/// <summary>
+		/// Read next input chunk from within the coroutine. 
+		/// If Empty is returned, the coroutine should yield, and will be resumed with the next chunk.
+		/// Call in worker thread only.
+		/// </summary>
+		/// <param name="out">Receives the chunk read</param>
+		/// <returns>Result of the read</returns>
+		CoTaskInput Read(std::string& out);
+
+		/// <summary>
+		/// Mark the coroutine as suspended by the worker at the end of its time slice, 
+		/// rather than by a yield in lua. No result is set for the yield.
+		/// Call in worker thread only.
+		/// </summary>
+		void Preempt();
+
+		/// <summary>
+		/// Check whether the coroutine is inside lua_resume, so it may be preempted. 
+		/// False while the function and arguments are evaluated before the first resume.
+		/// Call in worker thread only.
+		/// </summary>
+		/// <returns>True if resuming</returns>
+		bool IsResuming();
+
+		/// <summary>
+		/// Check whether the coroutine is suspended waiting for input
+		/// Call in worker thread only.
+		/// </summary>
+		/// <returns>True if suspended in Read</returns>
+		bool IsAwaitingInput();
+
+		/// <summary>
+		/// Check whether a coroutine waiting for input can be resumed
+		/// (input available, input closed, or task final)
+		/// </summary>
+		/// <returns>True if ready to resume</returns>
+		bool IsInputReady();
+
+		/// <summary>
+		/// Set object to wake when input is written
+		/// </summary>
+		/// <param name="listener">Object to wake</param>
+		void SetInputListener(const std::weak_ptr<Wakeable>& listener);
+
 	};
 }
 #endif
\ No newline at end of file
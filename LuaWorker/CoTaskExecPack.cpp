@@ -55,3 +55,18 @@ void CoTaskExecPack::Resume(lua_State* pL)
 	}
 }
 
+void CoTaskExecPack::SetThread(lua_State* pThread, int ref)
+{
+	mThread = pThread;
+	mThreadRef = ref;
+}
+
+lua_State* CoTaskExecPack::GetThread() const
+{
+	return mThread;
+}
+
+int CoTaskExecPack::GetThreadRef() const
+{
+	return mThreadRef;
+}
\ No newline at end of file
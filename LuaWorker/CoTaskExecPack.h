@@ -28,6 +28,11 @@
 
 //#include "TaskPackAcceptor.h"
 
+extern "C" {
+#include "lua.h"
+#include "lauxlib.h"
+}
+
 namespace LuaWorker
 {
 	/// <summary>
@@ -35,6 +40,12 @@ namespace LuaWorker
 	/// </summary>
 	class CoTaskExecPack : public TypedTaskExecPack<CoTask, CoTaskExecPack> {
 
+	private:
+
+		// Thread the task runs on, and its reference in the registry
+		lua_State* mThread = nullptr;
+		int mThreadRef = LUA_NOREF;
+
 	public:
 
 		/// <summary>
@@ -55,6 +66,25 @@ namespace LuaWorker
 		/// <param name="pL">The thread on which Exec was previously called</param>
 		void Resume(lua_State* pL);
 
+		/// <summary>
+		/// Record the thread the task runs on, while it is suspended
+		/// </summary>
+		/// <param name="pThread">Thread</param>
+		/// <param name="ref">Registry reference keeping the thread alive</param>
+		void SetThread(lua_State* pThread, int ref);
+
+		/// <summary>
+		/// Get the thread the task runs on
+		/// </summary>
+		/// <returns>The thread, or nullptr if not set</returns>
+		lua_State* GetThread() const;
+
+		/// <summary>
+		/// Get the registry reference to the thread the task runs on
+		/// </summary>
+		/// <returns>The reference, or LUA_NOREF</returns>
+		int GetThreadRef() const;
+
 	};
 }
 
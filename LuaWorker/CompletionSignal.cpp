@@ -0,0 +1,119 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#include "CompletionSignal.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstdint>
+#endif
+
+using namespace LuaWorker;
+
+//------
+#if defined(_WIN32)
+
+CompletionSignal::CompletionSignal() : mHandle(CreateEventW(nullptr, TRUE, FALSE, nullptr)), mSet(false) {}
+
+CompletionSignal::~CompletionSignal()
+{
+	if (IsValid()) CloseHandle(mHandle);
+}
+
+void CompletionSignal::Set()
+{
+	if (mSet || !IsValid()) return;
+
+	SetEvent(mHandle);
+	mSet = true;
+}
+
+void CompletionSignal::Reset()
+{
+	if (!mSet || !IsValid()) return;
+
+	ResetEvent(mHandle);
+	mSet = false;
+}
+
+bool CompletionSignal::IsValid() const
+{
+	return mHandle != nullptr;
+}
+
+//------
+#elif defined(__linux__)
+
+CompletionSignal::CompletionSignal() : mHandle(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), mSet(false) {}
+
+CompletionSignal::~CompletionSignal()
+{
+	if (IsValid()) close(mHandle);
+}
+
+void CompletionSignal::Set()
+{
+	// Written even if already set: the host may have read the fd since
+	if (!IsValid()) return;
+
+	uint64_t one = 1;
+	if (write(mHandle, &one, sizeof(one)) == sizeof(one)) mSet = true;
+}
+
+void CompletionSignal::Reset()
+{
+	if (!mSet || !IsValid()) return;
+
+	// Also clears any count the host added by writing to the fd
+	uint64_t count;
+	while (read(mHandle, &count, sizeof(count)) == sizeof(count)) {}
+	mSet = false;
+}
+
+bool CompletionSignal::IsValid() const
+{
+	return mHandle >= 0;
+}
+
+//------
+#else
+
+CompletionSignal::CompletionSignal() : mHandle(-1), mSet(false) {}
+
+CompletionSignal::~CompletionSignal() {}
+
+void CompletionSignal::Set() {}
+
+void CompletionSignal::Reset() {}
+
+bool CompletionSignal::IsValid() const
+{
+	return false;
+}
+
+#endif
+
+//------
+CompletionSignal::NativeHandle CompletionSignal::GetNativeHandle() const
+{
+	return mHandle;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _COMPLETION_SIGNAL_H_
+#define _COMPLETION_SIGNAL_H_
+#pragma once
+
+namespace LuaWorker
+{
+	/// <summary>
+	/// OS waitable object which is signalled (level-triggered) while set.
+	/// An eventfd on Linux, a manual-reset event on Windows.
+	/// </summary>
+	class CompletionSignal
+	{
+	public:
+
+#ifdef _WIN32
+		typedef void* NativeHandle;
+#else
+		typedef int NativeHandle;
+#endif
+
+	private:
+
+		NativeHandle mHandle;
+		bool mSet;
+
+	public:
+
+		CompletionSignal();
+		~CompletionSignal();
+
+		CompletionSignal(const CompletionSignal&) = delete;
+		CompletionSignal& operator=(const CompletionSignal&) = delete;
+
+		/// <summary>
+		/// Make the handle readable/signalled. On Linux this writes to the fd 
+		/// each time, so it is readable again even if the host read it since the last Set.
+		/// </summary>
+		void Set();
+
+		/// <summary>
+		/// Clear the signal, if set
+		/// </summary>
+		void Reset();
+
+		/// <summary>
+		/// Get the OS handle (file descriptor on Linux)
+		/// </summary>
+		/// <returns>The handle, or an invalid value if not supported on this platform</returns>
+		NativeHandle GetNativeHandle() const;
+
+		/// <summary>
+		/// Check whether the OS handle was created
+		/// </summary>
+		/// <returns>True if valid</returns>
+		bool IsValid() const;
+	};
+};
+#endif
\ No newline at end of file
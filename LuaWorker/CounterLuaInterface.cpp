@@ -0,0 +1,156 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#include <algorithm>
+#include <new>
+
+#include "CounterLuaInterface.h"
+
+using namespace LuaWorker;
+
+//-------------------------------
+// Static Lua helper methods
+//-------------------------------
+SharedCounter* CounterLuaInterface::l_ToCounter(lua_State* pL)
+{
+	// Upvalue is the userdata holding a shared_ptr to the counter. 
+	// Not copied, to keep increments free of reference counting.
+	std::shared_ptr<SharedCounter>* ppCounter = (std::shared_ptr<SharedCounter>*)lua_touserdata(pL, lua_upvalueindex(1));
+
+	return ppCounter == nullptr ? nullptr : ppCounter->get();
+}
+
+//-------------------------------
+// Public Static Lua-callable methods
+//-------------------------------
+int CounterLuaInterface::l_LuaWorker_Counter(lua_State* pL)
+{
+	if (!lua_isstring(pL, 1))
+	{
+		luaL_error(pL, "Counter name required!");
+		return 0;
+	}
+
+	size_t stripes = 1;
+	if (lua_isnumber(pL, 2)) stripes = (size_t)std::max((lua_Integer)1, lua_tointeger(pL, 2));
+
+	std::shared_ptr<SharedCounter> pCounter = SharedCounter::Open(lua_tostring(pL, 1), stripes);
+
+	lua_createtable(pL, 0, 5);
+
+	void* pMem = lua_newuserdata(pL, sizeof(std::shared_ptr<SharedCounter>));
+	new (pMem) std::shared_ptr<SharedCounter>(pCounter);
+		lua_createtable(pL, 0, 1);
+			lua_pushcfunction(pL, l_Counter_Delete);
+		lua_setfield(pL, -2, "__gc");
+	lua_setmetatable(pL, -2);
+
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_Counter_Add, 1);
+	lua_setfield(pL, -3, "Add");
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_Counter_Observe, 1);
+	lua_setfield(pL, -3, "Observe");
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_Counter_Value, 1);
+	lua_setfield(pL, -3, "Value");
+		lua_pushvalue(pL, -1);
+		lua_pushcclosure(pL, l_Counter_Range, 1);
+	lua_setfield(pL, -3, "Range");
+		lua_pushcclosure(pL, l_Counter_Reset, 1);
+	lua_setfield(pL, -2, "Reset");
+
+	return 1;
+}
+
+int CounterLuaInterface::l_Counter_Delete(lua_State* pL)
+{
+	std::shared_ptr<SharedCounter>* ppCounter = (std::shared_ptr<SharedCounter>*)lua_touserdata(pL, 1);
+
+	if (ppCounter != nullptr) ppCounter->~shared_ptr();
+
+	return 0;
+}
+
+int CounterLuaInterface::l_Counter_Add(lua_State* pL)
+{
+	SharedCounter* pCounter = l_ToCounter(pL);
+
+	if (pCounter != nullptr) pCounter->Add(lua_isnumber(pL, 2) ? (double)lua_tonumber(pL, 2) : 1.0);
+
+	return 0;
+}
+
+int CounterLuaInterface::l_Counter_Observe(lua_State* pL)
+{
+	SharedCounter* pCounter = l_ToCounter(pL);
+
+	if (pCounter == nullptr) return 0;
+
+	if (!lua_isnumber(pL, 2))
+	{
+		luaL_error(pL, "Observed value must be a number!");
+		return 0;
+	}
+
+	pCounter->Observe((double)lua_tonumber(pL, 2));
+
+	return 0;
+}
+
+int CounterLuaInterface::l_Counter_Value(lua_State* pL)
+{
+	SharedCounter* pCounter = l_ToCounter(pL);
+
+	if (pCounter == nullptr) return 0;
+
+	lua_pushnumber(pL, (lua_Number)pCounter->Read().total);
+	return 1;
+}
+
+int CounterLuaInterface::l_Counter_Range(lua_State* pL)
+{
+	SharedCounter* pCounter = l_ToCounter(pL);
+
+	if (pCounter == nullptr) return 0;
+
+	SharedCounter::Value value = pCounter->Read();
+
+	if (value.observed > 0)
+	{
+		lua_pushnumber(pL, (lua_Number)value.min);
+		lua_pushnumber(pL, (lua_Number)value.max);
+	}
+	else
+	{
+		lua_pushnil(pL);
+		lua_pushnil(pL);
+	}
+	lua_pushnumber(pL, (lua_Number)value.observed);
+
+	return 3;
+}
+
+int CounterLuaInterface::l_Counter_Reset(lua_State* pL)
+{
+	SharedCounter* pCounter = l_ToCounter(pL);
+
+	if (pCounter != nullptr) pCounter->Reset();
+
+	return 0;
+}
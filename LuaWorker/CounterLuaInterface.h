@@ -0,0 +1,131 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _COUNTER_LUA_INTERFACE_H_
+#define _COUNTER_LUA_INTERFACE_H_
+#pragma once
+
+#include <memory>
+
+#include "SharedCounter.h"
+
+extern "C" {
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+}
+
+namespace LuaWorker
+{
+	/// <summary>
+	/// Lua interface for process-wide shared counters
+	/// </summary>
+	class CounterLuaInterface
+	{
+	private:
+
+		//-------------------------------
+		// Static Lua helper methods
+		//-------------------------------
+
+		/// <summary>
+		/// Get the counter referenced by the calling closure
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Counter, kept alive by the closure</returns>
+		static SharedCounter* l_ToCounter(lua_State* pL);
+
+	public:
+
+		//-------------------------------
+		// Static Lua-callable methods
+		//-------------------------------
+
+		/// <summary>
+		/// Get the process-wide counter with the given name, creating it if needed
+		/// with the given number of stripes (each on its own cache line, used by
+		/// different threads).
+		/// 
+		/// Lua syntax:
+		///		local counter = LuaWorker.Counter(name, stripes)
+		///		local counter = InLuaWorker.Counter(name, stripes)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_LuaWorker_Counter(lua_State* pL);
+
+		/// <summary>
+		/// Release the handle's reference to the counter. Called by lua gc.
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Counter_Delete(lua_State* pL);
+
+		/// <summary>
+		/// Add to the counter's total (default 1)
+		/// 
+		/// Lua syntax:
+		///		counter:Add(n)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Counter_Add(lua_State* pL);
+
+		/// <summary>
+		/// Include a value in the counter's min and max
+		/// 
+		/// Lua syntax:
+		///		counter:Observe(x)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Counter_Observe(lua_State* pL);
+
+		/// <summary>
+		/// Return the counter's total
+		/// 
+		/// Lua syntax:
+		///		local total = counter:Value()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Counter_Value(lua_State* pL);
+
+		/// <summary>
+		/// Return the min and max of observed values (nil if none), 
+		/// and the number observed
+		/// 
+		/// Lua syntax:
+		///		local min, max, count = counter:Range()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Counter_Range(lua_State* pL);
+
+		/// <summary>
+		/// Set the total to zero and forget observed values
+		/// 
+		/// Lua syntax:
+		///		counter:Reset()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Counter_Reset(lua_State* pL);
+	};
+};
+#endif
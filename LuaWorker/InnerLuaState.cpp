@@ -27,10 +27,14 @@ extern "C" {
 }
 
 #include <chrono>
+#include <cstring>
+#include <algorithm>
 
 //#include "TaskExecPack.h"
 #include "OneShotTaskExecPack.h"
 #include "CoTaskExecPack.h"
+#include "CacheLuaInterface.h"
+#include "CounterLuaInterface.h"
 
 using namespace std::chrono_literals;
 using std::chrono::system_clock;
@@ -38,92 +42,67 @@ using std::chrono::system_clock;
 using namespace LuaWorker;
 
 const char* InnerLuaState::cLuaRegistryThisKey = "LUAWORKER_STATE_THIS";
-const char* InnerLuaState::cLuaRegistryThreadTableKey = "LUAWORKER_STATE_THREADS";
 const char* InnerLuaState::cInLuaWorkerTableName = "InLuaWorker";
 
+// Libraries which may be opened lazily. Base and package are always opened.
+static const luaL_Reg sStandardLibs[] = {
+	{LUA_TABLIBNAME, luaopen_table},
+	{LUA_IOLIBNAME, luaopen_io},
+	{LUA_OSLIBNAME, luaopen_os},
+	{LUA_STRLIBNAME, luaopen_string},
+	{LUA_MATHLIBNAME, luaopen_math},
+	{LUA_DBLIBNAME, luaopen_debug},
+	{NULL, NULL}
+};
+
 //----------------------
 // Private
 //----------------------
 
 bool InnerLuaState::HandleSuspendedTask(std::unique_ptr<CoTaskExecPack>&& task, std::chrono::system_clock::time_point resumeAt)
 {
-	if (mLua == nullptr) return false;
-
-	if (!lua_isthread(mLua, -1)) return false;
-
-	int prevTop = lua_gettop(mLua);
-
-	lua_pushlightuserdata(mLua, &cLuaRegistryThreadTableKey);
-	lua_gettable(mLua, LUA_REGISTRYINDEX);
-
-	if (!lua_istable(mLua, -1))
-	{
-		lua_settop(mLua, prevTop - 1);
-		return false;
-	}
+	if (mLua == nullptr || task->GetThread() == nullptr) return false;
 
 	T_SuspendedTaskCard card  = mResumableTasks.MakeCard(std::move(task),resumeAt);
 
-	lua_pushinteger(mLua, card.GetTag());
-
-	lua_insert(mLua, -3); // handle (key) below thread
-	lua_insert(mLua, -3); // Threads table below handle
-
-	lua_settable(mLua, -3); // Add thread to threads table at card tag index
-
-	T_SuspendedTaskCard::Return(std::move(card));
+	if (mCurrentTaskAwaitingInput) mInputWaitingTasks.push_back(std::move(card));
+	else T_SuspendedTaskCard::Return(std::move(card));
 
-	lua_settop(mLua, prevTop);
 	return true;
 }
 
-lua_State* InnerLuaState::GetTaskThread(int taskHandle)
+lua_State* InnerLuaState::AcquireThread(int& outRef)
 {
-	if (mLua == nullptr) return nullptr;
-
-	int prevTop = lua_gettop(mLua);
-
-	lua_pushlightuserdata(mLua, &cLuaRegistryThreadTableKey);
-	lua_gettable(mLua, LUA_REGISTRYINDEX);
-
-	if (!lua_istable(mLua, -1)) {
-		lua_settop(mLua, prevTop);
-		return nullptr;
-	}
-
-	lua_pushinteger(mLua, taskHandle);
-	lua_gettable(mLua, -2);
-
-	if (!lua_isthread(mLua, -1))
+	if (!mFreeThreads.empty())
 	{
-		lua_settop(mLua, prevTop);
-		return nullptr;
+		std::pair<lua_State*, int> thread = mFreeThreads.back();
+		mFreeThreads.pop_back();
+
+		outRef = thread.second;
+		return thread.first;
 	}
 
-	lua_State* taskThread = lua_tothread(mLua, -1);
-	lua_settop(mLua, prevTop);
+	lua_State* pThread = lua_newthread(mLua);
+	outRef = luaL_ref(mLua, LUA_REGISTRYINDEX);
 
-	return taskThread;
+	return pThread;
 }
 
-void InnerLuaState::RemoveTaskThread(int taskHandle)
+void InnerLuaState::ReleaseThread(lua_State* pThread, int ref)
 {
-	if (mLua == nullptr) return;
-
-	int prevTop = lua_gettop(mLua);
+	// Threads ending in an error are dead, and cancellation may have left others mid-call
+	if (!mCancel && lua_status(pThread) == 0 && mFreeThreads.size() < cMaxFreeThreads)
+	{
+		lua_settop(pThread, 0);
 
-	lua_pushlightuserdata(mLua, &cLuaRegistryThreadTableKey);
-	lua_gettable(mLua, LUA_REGISTRYINDEX);
+		// Undo any setfenv(0, ...) by the task
+		lua_pushvalue(mLua, LUA_GLOBALSINDEX);
+		lua_xmove(mLua, pThread, 1);
+		lua_replace(pThread, LUA_GLOBALSINDEX);
 
-	if (!lua_istable(mLua, -1)) {
-		lua_settop(mLua, prevTop);
-		return;
+		mFreeThreads.emplace_back(pThread, ref);
 	}
-
-	lua_pushinteger(mLua, taskHandle);
-	lua_pushnil(mLua);
-	lua_gettable(mLua, -3);
-	lua_settop(mLua, prevTop);
+	else luaL_unref(mLua, LUA_REGISTRYINDEX, ref);
 }
 
 //---------------------
@@ -137,6 +116,39 @@ InnerLuaState* InnerLuaState::l_PopThis(lua_State* pL)
 	return (InnerLuaState*)lua_topointer(pL, lua_upvalueindex(1));
 }
 
+//------
+int InnerLuaState::l_Panic(lua_State* pL)
+{
+	// Unprotected error. Lua aborts when this returns, so log it first.
+	lua_pushlightuserdata(pL, &cLuaRegistryThisKey);
+	lua_gettable(pL, LUA_REGISTRYINDEX);
+
+	if (lua_islightuserdata(pL, -1))
+	{
+		InnerLuaState* pState = (InnerLuaState*)lua_topointer(pL, -1);
+		const char* msg = lua_tostring(pL, -2);
+
+		pState->mLog.Push(LogLevel::Error, std::string("Unprotected lua error: ") + (msg != nullptr ? msg : "No Error Message!"));
+	}
+	return 0;
+}
+
+//------
+int InnerLuaState::l_IdleGCStep(lua_State* pL)
+{
+	InnerLuaState* pState = (InnerLuaState*)lua_touserdata(pL, 1);
+
+	if (lua_gc(pL, LUA_GCSTEP, cIdleGCStepSize) == 1) --pState->mIdleGCCyclesLeft; // Cycle finished
+	return 0;
+}
+
+//------
+int InnerLuaState::l_FullGC(lua_State* pL)
+{
+	lua_gc(pL, LUA_GCCOLLECT, 0);
+	return 0;
+}
+
 //------
 int InnerLuaState::l_Log(lua_State* pL, LogLevel level)
 {
@@ -229,6 +241,73 @@ int InnerLuaState::l_YieldFor(lua_State* pL)
 	return 0;
 }
 
+//------
+int InnerLuaState::l_Emit(lua_State* pL)
+{
+	InnerLuaState* pState = l_PopThis(pL);
+
+	if (pState != nullptr)
+	{
+		if (pState->mCurrentTask == nullptr)
+		{
+			lua_pushstring(pL, "Cannot emit here.");
+			lua_error(pL);
+			return 0;
+		}
+
+		if (!lua_isstring(pL, -1))
+		{
+			lua_pushstring(pL, "Emit expects parameters (<string>)");
+			lua_error(pL);
+			return 0;
+		}
+
+		size_t len = 0;
+		const char* item = lua_tolstring(pL, -1, &len);
+
+		pState->mCurrentTask->Emit(std::string(item, len));
+	}
+	return 0;
+}
+
+//------
+int InnerLuaState::l_Read(lua_State* pL)
+{
+	InnerLuaState* pState = l_PopThis(pL);
+
+	if (pState != nullptr)
+	{
+		CoTask* pTask = dynamic_cast<CoTask*>(pState->mCurrentTask.get());
+
+		if (!pState->mCurrentTaskCanYield || pTask == nullptr)
+		{
+			lua_pushstring(pL, "Cannot read here.");
+			lua_error(pL);
+			return 0;
+		}
+
+		std::string chunk;
+
+		switch (pTask->Read(chunk))
+		{
+		case CoTaskInput::Chunk:
+			lua_pushlstring(pL, chunk.data(), chunk.size());
+			return 1;
+		case CoTaskInput::Closed:
+			return 0;
+		default:
+			break;
+		}
+
+		// Wait for input. Resumed with the next chunk as the return value
+		pState->mCurrentTaskYielded = true;
+		pState->mCurrentTaskAwaitingInput = true;
+
+		return lua_yield(pL, 0);
+	}
+	return 0;
+}
+
 //------
 void InnerLuaState::l_Hook(lua_State* pL, lua_Debug* pDebug)
 {
@@ -253,29 +332,414 @@ void InnerLuaState::l_Hook(lua_State* pL, lua_Debug* pDebug)
 			lua_sethook(pL, InnerLuaState::l_Hook, 0,0);
 			throw LuaCancellationException();
 		}
+
+		if (pState->mCurrentTask != nullptr && pState->mCurrentTask->IsCancelled())
+		{
+			// Fails this task only. Interrupt every instruction from now on,
+			// so the error escapes any pcall in the task
+			pState->mHookCount = 1;
+			lua_sethook(pL, InnerLuaState::l_Hook, LUA_MASKCOUNT, 1);
+
+			lua_pushstring(pL, "Task cancelled.");
+			lua_error(pL);
+			return;
+		}
+
+		if (pDebug->event == LUA_HOOKCOUNT && pState->mCurrentBudget != nullptr)
+		{
+			if (!pState->mCurrentBudget->Charge(pState->mHookCount))
+			{
+				// Fails this task only. Check every instruction from now on,
+				// so the error escapes any pcall in the task
+				pState->mHookCount = 1;
+				lua_sethook(pL, InnerLuaState::l_Hook, LUA_MASKCOUNT, 1);
+
+				lua_pushstring(pL, "Task budget exceeded.");
+				lua_error(pL);
+				return;
+			}
+
+			if (pState->mCurrentBudget->GetCheckInterval() != pState->mHookCount) pState->InstallHook(pL);
+		}
+
+		if (pDebug->event == LUA_HOOKCOUNT && pState->mAllocator.ShouldCollect())
+		{
+			// Lua 5.1 has no emergency collection, so collect before a memory limit fails on garbage
+			lua_gc(pL, LUA_GCCOLLECT, 0);
+			pState->mAllocator.OnCollected();
+		}
+
+		if (pDebug->event == LUA_HOOKCOUNT && pState->mSliceActive && pL == pState->mRunningThread
+			&& std::chrono::steady_clock::now() >= pState->mSliceEnd && l_IsYieldSafe(pL))
+		{
+			CoTask* pTask = dynamic_cast<CoTask*>(pState->mCurrentTask.get());
+
+			// Not while the task's function and arguments are evaluated, before lua_resume
+			if (pTask != nullptr && pTask->IsResuming())
+			{
+				// Requeue behind coroutines already due. The worker takes new tasks first.
+				pTask->Preempt();
+				pState->mResumeCurrentTaskAt = system_clock::now();
+				pState->mCurrentTaskYielded = true;
+
+				lua_yield(pL, 0);
+				return;
+			}
+		}
+	}
+}
+
+//------
+int InnerLuaState::l_AuxResume(lua_State* pL, lua_State* pCo, int nArgs, InnerLuaState* pState)
+{
+	// Status as named by the base library
+	const char* status = nullptr;
+	lua_Debug ar;
+
+	if (pCo == pL) status = "running";
+	else if (lua_status(pCo) == 0)
+	{
+		if (lua_getstack(pCo, 0, &ar) > 0) status = "normal";
+		else if (lua_gettop(pCo) == 0) status = "dead";
+	}
+	else if (lua_status(pCo) != LUA_YIELD) status = "dead";
+
+	if (!lua_checkstack(pCo, nArgs)) luaL_error(pL, "too many arguments to resume");
+
+	if (status != nullptr)
+	{
+		lua_pushfstring(pL, "cannot resume %s coroutine", status);
+		return -1;
+	}
+
+	lua_xmove(pL, pCo, nArgs);
+
+	pState->PushResumedThread(pCo, pL);
+	int res = lua_resume(pCo, nArgs);
+	pState->PopResumedThread();
+
+	if (res == 0 || res == LUA_YIELD)
+	{
+		int nRes = lua_gettop(pCo);
+		if (!lua_checkstack(pL, nRes + 1)) luaL_error(pL, "too many results to resume");
+
+		lua_xmove(pCo, pL, nRes);
+		return nRes;
+	}
+
+	lua_xmove(pCo, pL, 1);
+	return -1;
+}
+
+//------
+int InnerLuaState::l_CoResume(lua_State* pL)
+{
+	lua_State* pCo = lua_tothread(pL, 1);
+	luaL_argcheck(pL, pCo != nullptr, 1, "coroutine expected");
+
+	int nRes = l_AuxResume(pL, pCo, lua_gettop(pL) - 1, (InnerLuaState*)lua_touserdata(pL, lua_upvalueindex(1)));
+
+	if (nRes < 0)
+	{
+		lua_pushboolean(pL, 0);
+		lua_insert(pL, -2);
+		return 2;
+	}
+
+	lua_pushboolean(pL, 1);
+	lua_insert(pL, -(nRes + 1));
+	return nRes + 1;
+}
+
+//------
+int InnerLuaState::l_CoWrap(lua_State* pL)
+{
+	luaL_checktype(pL, 1, LUA_TFUNCTION);
+
+	lua_State* pCo = lua_newthread(pL);
+	lua_pushvalue(pL, 1);
+	lua_xmove(pL, pCo, 1);
+
+	lua_pushvalue(pL, lua_upvalueindex(1));
+	lua_pushcclosure(pL, l_CoWrapAux, 2);
+	return 1;
+}
+
+//------
+int InnerLuaState::l_CoWrapAux(lua_State* pL)
+{
+	lua_State* pCo = lua_tothread(pL, lua_upvalueindex(1));
+
+	int nRes = l_AuxResume(pL, pCo, lua_gettop(pL), (InnerLuaState*)lua_touserdata(pL, lua_upvalueindex(2)));
+
+	if (nRes < 0)
+	{
+		if (lua_isstring(pL, -1))
+		{
+			luaL_where(pL, 1);
+			lua_insert(pL, -2);
+			lua_concat(pL, 2);
+		}
+		lua_error(pL);
+	}
+
+	return nRes;
+}
+
+//------
+bool InnerLuaState::l_IsYieldSafe(lua_State* pL)
+{
+	lua_Debug ar;
+
+	for (int level = 0; lua_getstack(pL, level, &ar); ++level)
+	{
+		// C function, or lost frames of a tail call
+		if (!lua_getinfo(pL, "Sn", &ar) || ar.what[0] == 'C' || ar.what[0] == 't') return false;
+
+		lua_Debug caller;
+		if (!lua_getstack(pL, level + 1, &caller)) break; // Coroutine body, started by lua_resume
+
+		if (ar.namewhat[0] == '\0') return false;
+		if (ar.name != nullptr && strcmp(ar.name, "(for generator)") == 0) return false;
+	}
+
+	return true;
+}
+
+//------
+void InnerLuaState::InstallHook(lua_State* pThread)
+{
+	int mask = 0;
+	int count = 0;
+
+	if (mCancelMode == CancelMode::Hook)
+	{
+		mask = LUA_MASKCALL | LUA_MASKCOUNT;
+		count = (int)1e7;
+	}
+
+	if (mCurrentBudget != nullptr)
+	{
+		mask |= LUA_MASKCOUNT;
+		count = mCurrentBudget->GetCheckInterval();
+	}
+
+	if (mSliceActive)
+	{
+		mask |= LUA_MASKCOUNT;
+		count = (mCurrentBudget != nullptr) ? std::min(count, cSliceCheckInterval) : cSliceCheckInterval;
+	}
+
+	if (mAllocator.IsLimited())
+	{
+		mask |= LUA_MASKCOUNT;
+		count = (count > 0) ? std::min(count, cMemoryCheckInterval) : cMemoryCheckInterval;
+	}
+
+	mHookCount = count;
+	lua_sethook(pThread, InnerLuaState::l_Hook, mask, count);
+}
+
+//------
+void InnerLuaState::SetRunningThread(lua_State* pThread)
+{
+	std::unique_lock<std::mutex> lock(mRunningThreadMtx);
+
+	if (pThread == nullptr)
+	{
+		if (mCurrentBudget != nullptr)
+		{
+			mCurrentBudget->Stop();
+			mCurrentBudget = nullptr;
+		}
+
+		mSliceActive = false;
+		mAllocator.EndTask();
+
+		mIdleGCCyclesLeft = cIdleGCCycles; // Lua ran, so there may be new garbage
+
+		// Undo budget, time slice or task interrupt hooks
+		if (mRunningThread != nullptr && !mCancel) InstallHook(mRunningThread);
+
+		mRunningThread = nullptr;
+		mRunningTask = nullptr;
+		mResumedThreads.clear();
+		return;
+	}
+
+	mRunningThread = pThread;
+	mRunningTask = mCurrentTask.get();
+
+	if (mCurrentTask != nullptr && mCurrentTask->GetBudget().IsLimited())
+	{
+		mCurrentBudget = &mCurrentTask->GetBudget();
+		mCurrentBudget->Start();
+	}
+
+	mAllocator.BeginTask((mCurrentTask != nullptr && mCurrentTask->GetBudget().HasMemoryLimit()) ? &mCurrentTask->GetBudget() : nullptr);
+
+	// Only coroutine tasks can be suspended at the end of a slice
+	if (mCurrentTask != nullptr && mCurrentTaskCanYield && mTimeSlice.count() > 0)
+	{
+		mSliceActive = true;
+		mSliceEnd = std::chrono::steady_clock::now() + mTimeSlice;
+	}
+
+	if (mCurrentBudget != nullptr || mSliceActive || mAllocator.IsLimited()) InstallHook(pThread);
+
+	// Cancel may have been requested before this thread was recorded
+	if ((mCancel && mCancelMode == CancelMode::Lazy) || (mCurrentTask != nullptr && mCurrentTask->IsCancelled()))
+	{
+		InterruptThread(pThread);
+	}
+}
+
+//------
+void InnerLuaState::PushResumedThread(lua_State* pCo, lua_State* pCaller)
+{
+	std::unique_lock<std::mutex> lock(mRunningThreadMtx);
+
+	mResumedThreads.push_back(pCo);
+
+	// Budget, time slice or interrupt hooks apply inside nested coroutines too
+	if (lua_gethook(pCaller) != nullptr) lua_sethook(pCo, lua_gethook(pCaller), lua_gethookmask(pCaller), lua_gethookcount(pCaller));
+
+	if ((mCancel && mCancelMode == CancelMode::Lazy) || (mCurrentTask != nullptr && mCurrentTask->IsCancelled()))
+	{
+		InterruptThread(pCo);
+	}
+}
+
+//------
+void InnerLuaState::PopResumedThread()
+{
+	std::unique_lock<std::mutex> lock(mRunningThreadMtx);
+
+	if (!mResumedThreads.empty()) mResumedThreads.pop_back();
+}
+
+//------
+void InnerLuaState::InterruptThread(lua_State* pThread)
+{
+	// lua_sethook is safe to call asynchronously
+	int mask = LUA_MASKCOUNT;
+	if (mCancelMode == CancelMode::Hook) mask |= LUA_MASKCALL;
+
+	mHookCount = 1;
+	lua_sethook(pThread, InnerLuaState::l_Hook, mask, 1);
+}
+
+//------
+InnerLuaState::RunningThreadScope::RunningThreadScope(InnerLuaState& state, lua_State* pThread) : mState(state)
+{
+	mState.SetRunningThread(pThread);
+}
+
+//------
+InnerLuaState::RunningThreadScope::~RunningThreadScope()
+{
+	mState.SetRunningThread(nullptr);
+}
+
+//------
+bool InnerLuaState::l_OpenLazyLib(lua_State* pL, int nameIndex)
+{
+	lua_pushvalue(pL, nameIndex);
+	lua_rawget(pL, lua_upvalueindex(1));
+
+	if (!lua_isnumber(pL, -1))
+	{
+		lua_pop(pL, 1);
+		return false;
 	}
+
+	const luaL_Reg& lib = sStandardLibs[lua_tointeger(pL, -1)];
+	lua_pop(pL, 1);
+
+	lua_pushvalue(pL, nameIndex);
+	lua_pushnil(pL);
+	lua_rawset(pL, lua_upvalueindex(1));
+
+	// Library tables outlive the task which happens to open them
+	LuaAllocator::UnlimitedScope unlimited(pL);
+
+	lua_pushcfunction(pL, lib.func);
+	lua_pushstring(pL, lib.name);
+	lua_call(pL, 1, 0);
+
+	return true;
+}
+
+//------
+int InnerLuaState::l_LazyIndex(lua_State* pL)
+{
+	if (!lua_isstring(pL, 2) || !l_OpenLazyLib(pL, 2)) return 0;
+
+	lua_pushvalue(pL, 2);
+	lua_rawget(pL, 1);
+	return 1;
+}
+
+//------
+int InnerLuaState::l_LazyRequire(lua_State* pL)
+{
+	const char* name = luaL_checkstring(pL, 1);
+
+	l_OpenLazyLib(pL, 1);
+
+	lua_getfield(pL, LUA_REGISTRYINDEX, "_LOADED");
+	lua_getfield(pL, -1, name);
+	return 1;
 }
 
 //---------------------
 // Public
 //---------------------
 
-InnerLuaState::InnerLuaState(LogSection&& log) 
+InnerLuaState::InnerLuaState(LogSection&& log, const WorkerOptions& options) 
 	: mLog(log), 
 	mCancel(false), 
+	mCancelMode(options.cancelMode),
+	mRunningThread(nullptr),
+	mRunningTask(nullptr),
+	mCurrentBudget(nullptr),
+	mHookCount(0),
+	mTimeSlice(options.timeSliceMillis),
+	mIdleGC(options.idleGC),
+	mLibs(options.libs),
+	mIdleGCCyclesLeft(0),
+	mSliceActive(false),
+	mSliceEnd(),
+	mAllocator(options.poolAllocator, options.maxMemory),
 	mLua(nullptr), 
 	mResumableTasks(),
 	mResumeCurrentTaskAt(),
 	mCurrentTaskYielded(),
-	mCurrentTaskCanYield(){}
-InnerLuaState::InnerLuaState(const LogSection& log) 
+	mCurrentTaskCanYield(),
+	mCurrentTaskAwaitingInput(),
+	mCurrentTask(){}
+InnerLuaState::InnerLuaState(const LogSection& log, const WorkerOptions& options) 
 	: mLog(log), 
 	mCancel(false), 
+	mCancelMode(options.cancelMode),
+	mRunningThread(nullptr),
+	mRunningTask(nullptr),
+	mCurrentBudget(nullptr),
+	mHookCount(0),
+	mTimeSlice(options.timeSliceMillis),
+	mIdleGC(options.idleGC),
+	mLibs(options.libs),
+	mIdleGCCyclesLeft(0),
+	mSliceActive(false),
+	mSliceEnd(),
+	mAllocator(options.poolAllocator, options.maxMemory),
 	mLua(nullptr), 
 	mResumableTasks(),
 	mResumeCurrentTaskAt(),
 	mCurrentTaskYielded(),
-	mCurrentTaskCanYield(){}
+	mCurrentTaskCanYield(),
+	mCurrentTaskAwaitingInput(),
+	mCurrentTask(){}
 
 //------
 InnerLuaState::~InnerLuaState()
@@ -295,9 +759,18 @@ void InnerLuaState::Open()
 {
 	if (mLua == nullptr && !mCancel) 
 	{
-		mLua = lua_open();
+		mLua = lua_newstate(LuaAllocator::l_Alloc, &mAllocator);
+
+		if (mLua == nullptr)
+		{
+			mLog.Push(LogLevel::Error, "Failed to allocate lua state.");
+			return;
+		}
 
-		luaL_openlibs(mLua);
+		lua_atpanic(mLua, InnerLuaState::l_Panic);
+
+		if (mLibs.has_value()) OpenLibs();
+		else luaL_openlibs(mLua);
 
 		// InLuaWorker object
 		lua_createtable(mLua, 0, 2);
@@ -318,19 +791,52 @@ void InnerLuaState::Open()
 		lua_pushcclosure(mLua, InnerLuaState::l_YieldFor, 1);
 		lua_setfield(mLua, -2, "YieldFor");
 
+		lua_pushlightuserdata(mLua, this);
+		lua_pushcclosure(mLua, InnerLuaState::l_Emit, 1);
+		lua_setfield(mLua, -2, "Emit");
+
+		lua_pushlightuserdata(mLua, this);
+		lua_pushcclosure(mLua, InnerLuaState::l_Read, 1);
+		lua_setfield(mLua, -2, "Read");
+
+		lua_pushcfunction(mLua, CacheLuaInterface::l_InLuaWorker_Cache);
+		lua_setfield(mLua, -2, "Cache");
+
+		lua_pushcfunction(mLua, CacheLuaInterface::l_LuaWorker_SharedCache);
+		lua_setfield(mLua, -2, "SharedCache");
+
+		lua_pushcfunction(mLua, CacheLuaInterface::l_LuaWorker_Snapshot);
+		lua_setfield(mLua, -2, "Snapshot");
+
+		lua_pushcfunction(mLua, CounterLuaInterface::l_LuaWorker_Counter);
+		lua_setfield(mLua, -2, "Counter");
+
 		lua_setglobal(mLua, cInLuaWorkerTableName);
 
+		// Coroutines resumed by tasks are tracked, so cancelling reaches lua running inside them
+		lua_getglobal(mLua, "coroutine");
+		if (lua_istable(mLua, -1))
+		{
+			lua_pushlightuserdata(mLua, this);
+			lua_pushcclosure(mLua, InnerLuaState::l_CoResume, 1);
+			lua_setfield(mLua, -2, "resume");
+
+			lua_pushlightuserdata(mLua, this);
+			lua_pushcclosure(mLua, InnerLuaState::l_CoWrap, 1);
+			lua_setfield(mLua, -2, "wrap");
+		}
+		lua_pop(mLua, 1);
+
 		// This pointer in registry
 		lua_pushlightuserdata(mLua, &cLuaRegistryThisKey);
 		lua_pushlightuserdata(mLua, this);
 		lua_settable(mLua, LUA_REGISTRYINDEX);
 
-		// Threads table in registry
-		lua_pushlightuserdata(mLua, &cLuaRegistryThreadTableKey);
-		lua_createtable(mLua, 0, 0);
-		lua_settable(mLua, LUA_REGISTRYINDEX);
-
-		lua_sethook(mLua, InnerLuaState::l_Hook, LUA_MASKCALL | LUA_MASKCOUNT, (int)1e7);
+		// Lazy mode installs a hook only when cancelled
+		if (mCancelMode == CancelMode::Hook)
+		{
+			lua_sethook(mLua, InnerLuaState::l_Hook, LUA_MASKCALL | LUA_MASKCOUNT, (int)1e7);
+		}
 
 		mOpen = true;
 	}
@@ -341,11 +847,14 @@ void InnerLuaState::Close()
 {
 	Cancel(); // Cancel before waiting for any running lua to complete
 
+	SetRunningThread(nullptr);
+
 	if (mLua != nullptr)
 	{
 		lua_close(mLua);
 		mLua = nullptr;
 		mOpen = false;
+		mFreeThreads.clear();
 	}
 }
 
@@ -359,9 +868,14 @@ void InnerLuaState::ExecTask(std::unique_ptr<OneShotTaskExecPack>&& task)
 		int prevTop = lua_gettop(mLua);
 
 		mCurrentTaskCanYield = false; // Block yields via InLuaWorker
+		mCurrentTask = task->GetTask();
 
-		task->Exec(mLua);
+		{
+			RunningThreadScope running(*this, mLua);
+			task->Exec(mLua);
+		}
 
+		mCurrentTask = nullptr;
 		lua_settop(mLua, prevTop);
 	}
 }
@@ -374,17 +888,27 @@ void InnerLuaState::ExecTask(std::unique_ptr < CoTaskExecPack>&& task)
 	{
 		int prevTop = lua_gettop(mLua);
 
-		lua_State* taskThread = lua_newthread(mLua);
+		int threadRef = LUA_NOREF;
+		lua_State* taskThread = AcquireThread(threadRef);
 
 		mCurrentTaskYielded = false;
 		mCurrentTaskCanYield = true;
+		mCurrentTaskAwaitingInput = false;
+		mCurrentTask = task->GetTask();
 
-		task->Exec(taskThread);
+		{
+			RunningThreadScope running(*this, taskThread);
+			task->Exec(taskThread);
+		}
+
+		mCurrentTask = nullptr;
 
 		if (mCurrentTaskYielded && lua_status(taskThread) == LUA_YIELD)
 		{
+			task->SetThread(taskThread, threadRef);
 			HandleSuspendedTask(std::move(task), mResumeCurrentTaskAt);
 		}
+		else ReleaseThread(taskThread, threadRef);
 
 		lua_settop(mLua, prevTop);
 	}
@@ -398,25 +922,110 @@ void InnerLuaState::ResumeTask()
 
 	if (!card.has_value()) return;
 
-	lua_State* taskThread = GetTaskThread(card.value().GetTag());
+	lua_State* taskThread = card.value().GetValue()->GetThread();
 
 	if (taskThread == nullptr) return;
 
 	mCurrentTaskYielded = false;
+	mCurrentTaskCanYield = true;
+	mCurrentTaskAwaitingInput = false;
+	mCurrentTask = card.value().GetValue()->GetTask();
 
-	card.value().GetValue()->Resume(taskThread);
+	{
+		RunningThreadScope running(*this, taskThread);
+		card.value().GetValue()->Resume(taskThread);
+	}
 
-	if (mCurrentTaskYielded)
+	mCurrentTask = nullptr;
+
+	if (mCurrentTaskYielded && mCurrentTaskAwaitingInput)
+	{
+		mInputWaitingTasks.push_back(std::move(card.value()));
+	}
+	else if (mCurrentTaskYielded)
 	{
 		card.value().SetSortKey(mResumeCurrentTaskAt);
 		T_SuspendedTaskCard::Return(std::move(card.value()));
 	}
 	else
 	{
-		RemoveTaskThread(card.value().GetTag());
+		ReleaseThread(taskThread, card.value().GetValue()->GetThreadRef());
+	}
+}
+
+
+//------
+void InnerLuaState::WakeInputWaiters()
+{
+	if (mInputWaitingTasks.empty()) return;
+
+	system_clock::time_point now = system_clock::now();
+
+	for (auto it = mInputWaitingTasks.begin(); it != mInputWaitingTasks.end();)
+	{
+		std::shared_ptr<CoTask> pTask = it->GetValue()->GetTask();
+
+		if (pTask == nullptr || pTask->IsInputReady() || pTask->IsCancelled())
+		{
+			it->SetSortKey(now);
+			T_SuspendedTaskCard::Return(std::move(*it));
+			it = mInputWaitingTasks.erase(it);
+		}
+		else ++it;
 	}
 }
 
+//------
+bool InnerLuaState::ProtectedGC(lua_CFunction gcFunc)
+{
+	// Finalizers run during collection may raise errors, which would otherwise reach l_Panic
+	if (lua_cpcall(mLua, gcFunc, this) == 0) return true;
+
+	const char* msg = lua_tostring(mLua, -1);
+	mLog.Push(LogLevel::Error, std::string("Error in garbage collection: ") + (msg != nullptr ? msg : "No Error Message!"));
+	lua_pop(mLua, 1);
+
+	return false;
+}
+
+//------
+bool InnerLuaState::HasIdleGCWork() const
+{
+	return mIdleGC && mLua != nullptr && !mCancel && mIdleGCCyclesLeft > 0;
+}
+
+//------
+void InnerLuaState::StepIdleGC()
+{
+	if (!HasIdleGCWork()) return;
+
+	ProtectedGC(InnerLuaState::l_IdleGCStep);
+}
+
+//------
+bool InnerLuaState::HasSuspendedTasks()
+{
+	return GetNextResume().has_value() || !mInputWaitingTasks.empty();
+}
+
+//------
+bool InnerLuaState::Hibernate(bool close)
+{
+	if (mLua == nullptr || mCancel || HasSuspendedTasks()) return false;
+
+	mIdleGCCyclesLeft = 0;
+
+	if (!close) return ProtectedGC(InnerLuaState::l_FullGC);
+
+	mOpen = false;
+	lua_close(mLua);
+	mLua = nullptr;
+	mFreeThreads.clear();
+
+	mAllocator.ReleaseArenas();
+
+	return true;
+}
 
 //------
 std::optional<std::chrono::system_clock::time_point> InnerLuaState::GetNextResume()
@@ -429,11 +1038,52 @@ void InnerLuaState::Cancel()
 {
 	mCancel = true;
 
+	if (mCancelMode == CancelMode::Lazy)
+	{
+		std::unique_lock<std::mutex> lock(mRunningThreadMtx);
+		if (mRunningThread != nullptr) InterruptThread(mRunningThread);
+		for (lua_State* pThread : mResumedThreads) InterruptThread(pThread);
+	}
+
 	mCancelCv.notify_all();
 }
 
+//------
+void InnerLuaState::CancelTask(const Task* task)
+{
+	std::unique_lock<std::mutex> lock(mRunningThreadMtx);
+
+	if (mRunningThread != nullptr && mRunningTask == task)
+	{
+		InterruptThread(mRunningThread);
+		for (lua_State* pThread : mResumedThreads) InterruptThread(pThread);
+	}
+}
+
 //------
 bool InnerLuaState::IsOpen()
 {
 	return mOpen;
+}
+
+//------
+bool InnerLuaState::IsStandardLib(const std::string& name)
+{
+	for (int i = 0; sStandardLibs[i].func != NULL; i++)
+	{
+		if (name == sStandardLibs[i].name) return true;
+	}
+	return false;
+}
+
+//------
+void InnerLuaState::SetLog(const LogSection& log)
+{
+	mLog = log;
+}
+
+//------
+AllocatorStats InnerLuaState::GetMemoryStats() const
+{
+	return mAllocator.GetStats();
 }
\ No newline at end of file
@@ -20,16 +20,24 @@
 #define _INNER_LUA_STATE_H_
 #pragma once
 
+#include <atomic> 
 #include <mutex> 
 #include <chrono> 
+#include <list> 
+#include <optional> 
+#include <string> 
+#include <vector> 
 
 #include "Cancelable.h"
 #include "AutoKeyLoanDeck.h"
 
 #include "LogSection.h"
+#include "Task.h"
 //#include "OneShotTaskExecPack.h"
 //#include "CoTaskExecPack.h"
 #include "TaskPackAcceptor.h"
+#include "WorkerOptions.h"
+#include "LuaAllocator.h"
 
 extern "C" {
 #include "lua.h"
@@ -58,13 +66,30 @@ namespace LuaWorker
 		const static char* cLuaRegistryThisKey;
 
 		/// <summary>
-		/// Lua registry key to table of instance threads
-		/// Use address of this as the actual key to instance data table in the lua registry 
-		/// (as there's a different lua state per instance, there won't be clashes between instances)
+		/// Max finished coroutine threads kept for reuse
 		/// </summary>
-		const static char* cLuaRegistryThreadTableKey;
+		const static std::size_t cMaxFreeThreads = 32;
 		const static char* cInLuaWorkerTableName;
 
+		/// <summary>
+		/// Instructions between checks of the time slice of a running coroutine
+		/// </summary>
+		const static int cSliceCheckInterval = 1000;
+
+		// Max instructions between checks for garbage to collect while memory is limited
+		const static int cMemoryCheckInterval = 1000;
+
+		/// <summary>
+		/// Size of an idle collection step (KB, as passed to lua_gc)
+		/// </summary>
+		const static int cIdleGCStepSize = 8;
+
+		/// <summary>
+		/// Complete collection cycles to run when idle after a task.
+		/// The first may have begun before the task's garbage was created.
+		/// </summary>
+		const static int cIdleGCCycles = 2;
+
 
 		std::atomic<bool> mCancel;
 		std::atomic<bool> mOpen;
@@ -72,40 +97,165 @@ namespace LuaWorker
 		std::mutex mCancelMtx;
 		std::condition_variable mCancelCv;
 
+		const CancelMode mCancelMode;
+
+		// Thread executing lua, and its task, if any. Used by Cancel and CancelTask
+		lua_State* mRunningThread;
+		const Task* mRunningTask;
+		std::mutex mRunningThreadMtx;
+
+		// Coroutines being resumed by coroutine.resume/wrap, innermost last. 
+		// Interrupted with mRunningThread, as lua code may be running in any of them. Guarded by mRunningThreadMtx.
+		std::vector<lua_State*> mResumedThreads;
+
+		//Access in worker thread only
+		TaskBudget* mCurrentBudget;
+
+		// Count of the installed lua hook. Also set by InterruptThread when cancelling from another thread
+		std::atomic<int> mHookCount;
+
+		// Time slice for coroutine tasks, or zero
+		const std::chrono::milliseconds mTimeSlice;
+
+		const bool mIdleGC;
+
+		// Standard libraries opened with the state, or all if not set
+		const std::optional<std::vector<std::string>> mLibs;
+
+		//Access in worker thread only
+		int mIdleGCCyclesLeft;
+
+		//Access in worker thread only
+		bool mSliceActive;
+		std::chrono::steady_clock::time_point mSliceEnd;
+
 		LogSection mLog;
 
+		// Outlives mLua
+		LuaAllocator mAllocator;
+
 		//Access in worker thread only
 		lua_State* mLua;
 
 		//Access in worker thread only
 		T_SuspendedTaskDeck mResumableTasks;
 
+		//Access in worker thread only
+		std::list<T_SuspendedTaskCard> mInputWaitingTasks;
+
+		//Access in worker thread only. Finished threads, with their registry references.
+		std::vector<std::pair<lua_State*, int>> mFreeThreads;
+
 		std::chrono::system_clock::time_point mResumeCurrentTaskAt;
 		bool mCurrentTaskYielded;
 		bool mCurrentTaskCanYield;
+		bool mCurrentTaskAwaitingInput;
+
+		//Access in worker thread only
+		std::shared_ptr<Task> mCurrentTask;
+
+		/// <summary>
+		/// Records the thread executing lua for the lifetime of this object
+		/// </summary>
+		class RunningThreadScope
+		{
+		private:
+			InnerLuaState& mState;
+
+		public:
+			RunningThreadScope(InnerLuaState& state, lua_State* pThread);
+			~RunningThreadScope();
+		};
 
 		//---------------------
 		// Private methods
 		//---------------------
 
+		/// <summary>
+		/// Install the hook for the cancel mode and current task budget on a thread.
+		/// Call from worker thread only.
+		/// </summary>
+		/// <param name="pThread">Thread to set the hook on</param>
+		void InstallHook(lua_State* pThread);
+
+		/// <summary>
+		/// Install a hook on a thread to run at its next instruction
+		/// Call with mRunningThreadMtx held.
+		/// </summary>
+		/// <param name="pThread">Thread to interrupt</param>
+		void InterruptThread(lua_State* pThread);
+
+		/// <summary>
+		/// Record a coroutine about to be resumed from lua. It gets the hook of the thread
+		/// resuming it, and is interrupted at once if the worker (Lazy mode) or task is already cancelled.
+		/// Call from worker thread only.
+		/// </summary>
+		/// <param name="pCo">Coroutine to resume</param>
+		/// <param name="pCaller">Thread resuming it</param>
+		void PushResumedThread(lua_State* pCo, lua_State* pCaller);
+
+		/// <summary>
+		/// Forget the innermost coroutine recorded by PushResumedThread, once it has yielded or returned.
+		/// Call from worker thread only.
+		/// </summary>
+		void PopResumedThread();
+
+		/// <summary>
+		/// Set the thread executing lua, and start or stop the current task's budget and time slice. 
+		/// If the worker (Lazy mode) or task is already cancelled, interrupt it.
+		/// Call from worker thread only.
+		/// </summary>
+		/// <param name="pThread">Running thread, or nullptr</param>
+		void SetRunningThread(lua_State* pThread);
+
 		/// <summary>
 		/// Call from worker thread only
-		/// The thread on which the task runs must be at the top of the stack for the internal state (mLua)
-		/// If there is a thread at index -1, it is popped
+		/// The thread on which the task runs must be set on the task pack
 		/// <param name="task">Task to push</param>
 		/// <param name="resumeAt">Target resume time for this task</param>
 		/// </summary>
 		bool HandleSuspendedTask(std::unique_ptr<CoTaskExecPack>&& task, std::chrono::system_clock::time_point resumeAt);
 
-		lua_State* GetTaskThread(int taskHandle);
+		/// <summary>
+		/// Open the base and package libraries, and the standard libraries in mLibs. 
+		/// Other standard libraries open when their global is first read, or when required.
+		/// Call from worker thread only.
+		/// </summary>
+		void OpenLibs();
 
-		void RemoveTaskThread(int taskHandle);
+		/// <summary>
+		/// Take a thread for a coroutine task, reusing a finished one if possible.
+		/// Call from worker thread only.
+		/// </summary>
+		/// <param name="outRef">Registry reference keeping the thread alive</param>
+		/// <returns>The thread</returns>
+		lua_State* AcquireThread(int& outRef);
+
+		/// <summary>
+		/// Release the thread of a coroutine task which is not suspended. 
+		/// Threads which finished cleanly are kept for reuse, others are unreferenced.
+		/// Call from worker thread only.
+		/// </summary>
+		/// <param name="pThread">Thread from AcquireThread</param>
+		/// <param name="ref">Its registry reference</param>
+		void ReleaseThread(lua_State* pThread, int ref);
+
+		/// <summary>
+		/// Run a garbage collection function in protected mode, logging any error raised by a __gc metamethod.
+		/// Call in worker thread only, outside tasks.
+		/// </summary>
+		/// <param name="gcFunc">Function to call with this as lightuserdata argument</param>
+		/// <returns>True if no error was raised</returns>
+		bool ProtectedGC(lua_CFunction gcFunc);
 
 		//---------------------
 		// InnerLuaState
 		// Lua C methods
 		//---------------------
 		static InnerLuaState* l_PopThis(lua_State* pL);
+		static int l_Panic(lua_State* pL);
+		static int l_IdleGCStep(lua_State* pL);
+		static int l_FullGC(lua_State* pL);
 		static int l_Log(lua_State* pL, LogLevel level);
 		static int l_LogError(lua_State* pL);
 		static int l_LogInfo(lua_State* pL);
@@ -114,6 +264,70 @@ namespace LuaWorker
 
 		static void l_Hook(lua_State* pL, lua_Debug *pDebug);
 
+		/// <summary>
+		/// Resume a coroutine as coroutine.resume does in the base library, 
+		/// recording it for the duration so that cancelling can interrupt it.
+		/// </summary>
+		/// <param name="pL">Calling thread</param>
+		/// <param name="pCo">Coroutine to resume</param>
+		/// <param name="nArgs">Number of arguments at the top of the caller's stack</param>
+		/// <param name="pState">This state</param>
+		/// <returns>Number of results pushed, or -1 if the coroutine raised an error (message pushed)</returns>
+		static int l_AuxResume(lua_State* pL, lua_State* pCo, int nArgs, InnerLuaState* pState);
+
+		/// <summary>
+		/// Replaces coroutine.resume. Upvalue 1 is this.
+		/// </summary>
+		/// <param name="pL"></param>
+		/// <returns></returns>
+		static int l_CoResume(lua_State* pL);
+
+		/// <summary>
+		/// Replaces coroutine.wrap. Upvalue 1 is this.
+		/// </summary>
+		/// <param name="pL"></param>
+		/// <returns></returns>
+		static int l_CoWrap(lua_State* pL);
+
+		/// <summary>
+		/// Function returned by coroutine.wrap. Upvalue 1 is the coroutine, upvalue 2 is this.
+		/// </summary>
+		/// <param name="pL"></param>
+		/// <returns></returns>
+		static int l_CoWrapAux(lua_State* pL);
+
+		/// <summary>
+		/// Open a standard library not yet opened, named by a stack value.
+		/// Upvalue 1 must be the table of unopened library indices by name, shared by l_LazyIndex and l_LazyRequire.
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="nameIndex">Stack index of the name</param>
+		/// <returns>True if the library was opened</returns>
+		static bool l_OpenLazyLib(lua_State* pL, int nameIndex);
+
+		/// <summary>
+		/// __index metamethod of the globals table, opening standard libraries on first access
+		/// </summary>
+		/// <param name="pL"></param>
+		/// <returns></returns>
+		static int l_LazyIndex(lua_State* pL);
+
+		/// <summary>
+		/// Loader in package.preload for standard libraries not yet opened
+		/// </summary>
+		/// <param name="pL"></param>
+		/// <returns></returns>
+		static int l_LazyRequire(lua_State* pL);
+
+		/// <summary>
+		/// Check whether a hook can yield the thread. 
+		/// Lua 5.1 cannot resume across C calls, metamethods or for iterators, which all reach 
+		/// lua functions without a named call instruction.
+		/// </summary>
+		/// <param name="pL">Thread in a count hook</param>
+		/// <returns>True if only lua functions called by name are on the stack</returns>
+		static bool l_IsYieldSafe(lua_State* pL);
+
 		/// <summary>
 		/// 
 		/// Lua syntax:
@@ -123,18 +337,41 @@ namespace LuaWorker
 		/// <returns></returns>
 		static int l_YieldFor(lua_State* pL);
 
+		/// <summary>
+		/// Queue a partial result on the current task, to be drained by the caller
+		/// 
+		/// Lua syntax:
+		///		InLuaWorker.Emit( resultString )
+		/// </summary>
+		/// <param name="pL"></param>
+		/// <returns></returns>
+		static int l_Emit(lua_State* pL);
+
+		/// <summary>
+		/// Read the next input chunk written to the current coroutine task, 
+		/// yielding until one is available. Returns nothing at the end of input.
+		/// 
+		/// Lua syntax:
+		///		local chunk = InLuaWorker.Read()
+		/// </summary>
+		/// <param name="pL"></param>
+		/// <returns></returns>
+		static int l_Read(lua_State* pL);
+
 	public:
 		/// <summary>
 		/// Constructor
 		/// </summary>
 		/// <param name="log">Logger to use</param>
-		explicit InnerLuaState(LogSection&& log);
+		/// <param name="options">Worker settings</param>
+		explicit InnerLuaState(LogSection&& log, const WorkerOptions& options = WorkerOptions());
 
 		/// <summary>
 		/// Constructor
 		/// </summary>
 		/// <param name="log">Logger to copy</param>
-		explicit InnerLuaState(const LogSection& log);
+		/// <param name="options">Worker settings</param>
+		explicit InnerLuaState(const LogSection& log, const WorkerOptions& options = WorkerOptions());
 
 		/// <summary>
 		/// Destructor
@@ -176,6 +413,41 @@ namespace LuaWorker
 		/// <param name="resumeToken">Handle to task to return</param>
 		void ResumeTask();
 
+		/// <summary>
+		/// Make coroutines waiting for input resumable, if their input is ready
+		/// Call in worker thread only.
+		/// </summary>
+		void WakeInputWaiters();
+
+		/// <summary>
+		/// Check whether idle garbage collection is enabled, and has not finished since the last task ran
+		/// Call in worker thread only.
+		/// </summary>
+		/// <returns>True if StepIdleGC has work to do</returns>
+		bool HasIdleGCWork() const;
+
+		/// <summary>
+		/// Run one bounded step of garbage collection.
+		/// Call in worker thread only, when no task is ready.
+		/// </summary>
+		void StepIdleGC();
+
+		/// <summary>
+		/// Check whether coroutine tasks are suspended in the lua state, to be resumed or awaiting input.
+		/// Call in worker thread only.
+		/// </summary>
+		/// <returns>True if any</returns>
+		bool HasSuspendedTasks();
+
+		/// <summary>
+		/// Collect all garbage, or close the lua state and free its memory, 
+		/// unless tasks are suspended in it. A closed state can be opened again. 
+		/// Call in worker thread only, between tasks.
+		/// </summary>
+		/// <param name="close">True to close the state</param>
+		/// <returns>True on success. False if skipped, or a finalizer raised an error (logged)</returns>
+		bool Hibernate(bool close);
+
 		/// <summary>
 		/// Get time of next resumable task in queue
 		/// Call in worker thread only.
@@ -188,12 +460,40 @@ namespace LuaWorker
 		/// </summary>
 		void Cancel();
 
+		/// <summary>
+		/// Interrupt a cancelled task, if it is running
+		/// Can be called from any thread
+		/// </summary>
+		/// <param name="task">Task cancelled</param>
+		void CancelTask(const Task* task);
+
 		/// <summary>
 		/// Get whether lua state is open
 		/// Can be called from any thread
 		/// </summary>
 		/// <returns></returns>
 		bool IsOpen();
+
+		/// <summary>
+		/// Check whether a name is a standard library which can be opened lazily
+		/// </summary>
+		/// <param name="name">Library name</param>
+		/// <returns>True if known</returns>
+		static bool IsStandardLib(const std::string& name);
+
+		/// <summary>
+		/// Set the logger for messages from lua
+		/// Call in worker thread only.
+		/// </summary>
+		/// <param name="log">Logger to copy</param>
+		void SetLog(const LogSection& log);
+
+		/// <summary>
+		/// Get allocation counters for the lua state
+		/// Can be called from any thread
+		/// </summary>
+		/// <returns>Stats snapshot</returns>
+		AllocatorStats GetMemoryStats() const;
 	};
 }
 
@@ -0,0 +1,390 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "LuaAllocator.h"
+
+extern "C" {
+#include "lua.h"
+}
+
+using namespace LuaWorker;
+
+LuaAllocator::LuaAllocator(bool pooled, std::size_t maxBytes)
+	: mPooled(pooled),
+	mMaxBytes(maxBytes),
+	mEnforcing(false),
+	mTaskBudget(nullptr),
+	mUnlimitedDepth(0),
+	mBytesAfterCollect(0),
+	mFreeLists(),
+	mArenas(nullptr),
+	mArenaNext(nullptr),
+	mArenaLeft(0),
+	mBytesInUse(0),
+	mPeakBytesInUse(0),
+	mAllocations(0),
+	mPooledAllocations(0),
+	mArenaBytes(0),
+	mFailedAllocations(0) {}
+
+//------
+LuaAllocator::~LuaAllocator()
+{
+	ReleaseArenas();
+}
+
+//-------------------------------
+// Private methods
+//-------------------------------
+
+bool LuaAllocator::IsPooled(std::size_t size) const
+{
+	return mPooled && size <= cClassCount * cGranularity;
+}
+
+//------
+std::size_t LuaAllocator::ClassOf(std::size_t size)
+{
+	return size == 0 ? 0 : (size - 1) / cGranularity;
+}
+
+//------
+void* LuaAllocator::CarveBlock(std::size_t classIndex)
+{
+	std::size_t blockSize = (classIndex + 1) * cGranularity;
+
+	if (mArenaLeft < blockSize)
+	{
+		void* arena = std::malloc(cArenaSize);
+		if (arena == nullptr) return nullptr;
+
+		// Remainder of the current arena is a whole number of granules
+		if (mArenaLeft >= cGranularity)
+		{
+			std::size_t remainderClass = mArenaLeft / cGranularity - 1;
+			*(void**)mArenaNext = mFreeLists[remainderClass];
+			mFreeLists[remainderClass] = mArenaNext;
+		}
+
+		*(void**)arena = mArenas;
+		mArenas = arena;
+
+		// First granule holds the arena link
+		mArenaNext = (char*)arena + cGranularity;
+		mArenaLeft = cArenaSize - cGranularity;
+		mArenaBytes.fetch_add(cArenaSize, std::memory_order_relaxed);
+	}
+
+	void* block = mArenaNext;
+	mArenaNext += blockSize;
+	mArenaLeft -= blockSize;
+
+	return block;
+}
+
+//------
+void* LuaAllocator::ShrinkIntoPool(void* ptr, std::size_t osize, std::size_t nsize)
+{
+	std::size_t blockSize = (ClassOf(nsize) + 1) * cGranularity;
+	std::size_t arenaSize = blockSize + cGranularity;
+
+	void* arena = std::malloc(arenaSize);
+	char* block = nullptr;
+
+	if (arena != nullptr)
+	{
+		block = (char*)arena + cGranularity;
+		std::memcpy(block, ptr, nsize);
+		std::free(ptr);
+	}
+	else if (osize >= arenaSize)
+	{
+		// First granule of the old block holds the arena link, so move the data up
+		arena = ptr;
+		arenaSize = osize;
+		block = (char*)arena + cGranularity;
+		std::memmove(block, ptr, nsize);
+	}
+	else
+	{
+		// Last resort, within a few bytes of the largest class and with no memory left at all.
+		// The block joins the pool when freed, and is not returned to the system.
+		RemoveInUse(osize);
+		AddInUse(nsize);
+		return ptr;
+	}
+
+	*(void**)arena = mArenas;
+	mArenas = arena;
+	mArenaBytes.fetch_add(arenaSize, std::memory_order_relaxed);
+
+	RemoveInUse(osize);
+	AddInUse(nsize);
+
+	return block;
+}
+
+//------
+void* LuaAllocator::AllocBlock(std::size_t size)
+{
+	void* block = nullptr;
+
+	if (IsPooled(size))
+	{
+		std::size_t classIndex = ClassOf(size);
+
+		block = mFreeLists[classIndex];
+		if (block != nullptr) mFreeLists[classIndex] = *(void**)block;
+		else block = CarveBlock(classIndex);
+
+		if (block != nullptr) mPooledAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+	else block = std::malloc(size);
+
+	if (block != nullptr)
+	{
+		mAllocations.fetch_add(1, std::memory_order_relaxed);
+		AddInUse(size);
+	}
+
+	return block;
+}
+
+//------
+void LuaAllocator::FreeBlock(void* ptr, std::size_t size)
+{
+	if (IsPooled(size))
+	{
+		std::size_t classIndex = ClassOf(size);
+		*(void**)ptr = mFreeLists[classIndex];
+		mFreeLists[classIndex] = ptr;
+	}
+	else std::free(ptr);
+
+	RemoveInUse(size);
+}
+
+//------
+void* LuaAllocator::Resize(void* ptr, std::size_t osize, std::size_t nsize)
+{
+	if (nsize == 0)
+	{
+		if (ptr != nullptr) FreeBlock(ptr, osize);
+		return nullptr;
+	}
+
+	if (ptr == nullptr) return AllocBlock(nsize);
+
+	bool oldPooled = IsPooled(osize);
+	bool newPooled = IsPooled(nsize);
+
+	if (oldPooled && newPooled && ClassOf(osize) == ClassOf(nsize))
+	{
+		RemoveInUse(osize);
+		AddInUse(nsize);
+		return ptr;
+	}
+
+	if (!oldPooled && !newPooled)
+	{
+		void* block = std::realloc(ptr, nsize);
+		if (block == nullptr) return nullptr;
+
+		RemoveInUse(osize);
+		AddInUse(nsize);
+		return block;
+	}
+
+	void* block = AllocBlock(nsize);
+
+	if (block == nullptr)
+	{
+		if (nsize > osize) return nullptr;
+
+		// Lua assumes shrinking cannot fail
+		if (!oldPooled) return ShrinkIntoPool(ptr, osize, nsize);
+
+		// Keep the larger pooled block. When freed as the smaller size it joins that class.
+		RemoveInUse(osize);
+		AddInUse(nsize);
+		return ptr;
+	}
+
+	std::memcpy(block, ptr, std::min(osize, nsize));
+	FreeBlock(ptr, osize);
+
+	return block;
+}
+
+//------
+void* LuaAllocator::Realloc(void* ptr, std::size_t osize, std::size_t nsize)
+{
+	if (ptr == nullptr) osize = 0;
+
+	if (nsize > osize && !Reserve(nsize - osize))
+	{
+		mFailedAllocations.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	void* block = Resize(ptr, osize, nsize);
+
+	if (nsize > osize && block == nullptr)
+	{
+		Release(nsize - osize);
+		mFailedAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+	else if (osize > nsize) Release(osize - nsize);
+
+	return block;
+}
+
+//------
+bool LuaAllocator::Reserve(std::size_t bytes)
+{
+	if (!mEnforcing || mUnlimitedDepth > 0) return true;
+
+	if (mMaxBytes > 0 && mBytesInUse.load(std::memory_order_relaxed) + bytes > mMaxBytes) return false;
+
+	return mTaskBudget == nullptr || mTaskBudget->ReserveMemory(bytes);
+}
+
+//------
+void LuaAllocator::Release(std::size_t bytes)
+{
+	if (mTaskBudget != nullptr) mTaskBudget->ReleaseMemory(bytes);
+}
+
+//------
+void LuaAllocator::AddInUse(std::size_t size)
+{
+	// Single writer, so load and store are not racing other updates
+	std::size_t inUse = mBytesInUse.load(std::memory_order_relaxed) + size;
+	mBytesInUse.store(inUse, std::memory_order_relaxed);
+
+	if (inUse > mPeakBytesInUse.load(std::memory_order_relaxed)) mPeakBytesInUse.store(inUse, std::memory_order_relaxed);
+}
+
+//------
+void LuaAllocator::RemoveInUse(std::size_t size)
+{
+	mBytesInUse.store(mBytesInUse.load(std::memory_order_relaxed) - size, std::memory_order_relaxed);
+}
+
+//-------------------------------
+// Public methods
+//-------------------------------
+
+void* LuaAllocator::l_Alloc(void* ud, void* ptr, std::size_t osize, std::size_t nsize)
+{
+	return ((LuaAllocator*)ud)->Realloc(ptr, osize, nsize);
+}
+
+//------
+void LuaAllocator::ReleaseArenas()
+{
+	while (mArenas != nullptr)
+	{
+		void* next = *(void**)mArenas;
+		std::free(mArenas);
+		mArenas = next;
+	}
+
+	mFreeLists.fill(nullptr);
+	mArenaNext = nullptr;
+	mArenaLeft = 0;
+	mArenaBytes.store(0, std::memory_order_relaxed);
+}
+
+//------
+void LuaAllocator::BeginTask(TaskBudget* budget)
+{
+	mEnforcing = true;
+	mTaskBudget = budget;
+	mBytesAfterCollect = mBytesInUse.load(std::memory_order_relaxed);
+}
+
+//------
+void LuaAllocator::EndTask()
+{
+	mEnforcing = false;
+	mTaskBudget = nullptr;
+}
+
+//------
+bool LuaAllocator::IsLimited() const
+{
+	return mEnforcing && (mMaxBytes > 0 || mTaskBudget != nullptr);
+}
+
+//------
+bool LuaAllocator::ShouldCollect() const
+{
+	if (!IsLimited()) return false;
+
+	std::size_t inUse = mBytesInUse.load(std::memory_order_relaxed);
+	if (inUse <= mBytesAfterCollect) return false;
+
+	std::size_t grown = inUse - mBytesAfterCollect;
+
+	if (mMaxBytes > 0 && grown >= mMaxBytes - std::min(inUse, mMaxBytes)) return true;
+
+	return mTaskBudget != nullptr && grown >= mTaskBudget->GetMemoryLeft();
+}
+
+//------
+void LuaAllocator::OnCollected()
+{
+	mBytesAfterCollect = mBytesInUse.load(std::memory_order_relaxed);
+}
+
+//------
+LuaAllocator::UnlimitedScope::UnlimitedScope(lua_State* pL) : mAllocator(nullptr)
+{
+	void* ud = nullptr;
+
+	if (lua_getallocf(pL, &ud) == LuaAllocator::l_Alloc) mAllocator = (LuaAllocator*)ud;
+
+	if (mAllocator != nullptr) ++mAllocator->mUnlimitedDepth;
+}
+
+//------
+LuaAllocator::UnlimitedScope::~UnlimitedScope()
+{
+	if (mAllocator != nullptr) --mAllocator->mUnlimitedDepth;
+}
+
+//------
+AllocatorStats LuaAllocator::GetStats() const
+{
+	AllocatorStats stats;
+
+	stats.bytesInUse = mBytesInUse.load(std::memory_order_relaxed);
+	stats.peakBytesInUse = mPeakBytesInUse.load(std::memory_order_relaxed);
+	stats.allocations = mAllocations.load(std::memory_order_relaxed);
+	stats.pooledAllocations = mPooledAllocations.load(std::memory_order_relaxed);
+	stats.arenaBytes = mArenaBytes.load(std::memory_order_relaxed);
+	stats.maxBytes = mMaxBytes;
+	stats.failedAllocations = mFailedAllocations.load(std::memory_order_relaxed);
+
+	return stats;
+}
@@ -0,0 +1,236 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _LUA_ALLOCATOR_H_
+#define _LUA_ALLOCATOR_H_
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+#include "TaskBudget.h"
+
+struct lua_State;
+
+namespace LuaWorker
+{
+	/// <summary>
+	/// Snapshot of the allocation counters of a lua state
+	/// </summary>
+	struct AllocatorStats
+	{
+		std::size_t bytesInUse = 0;
+		std::size_t peakBytesInUse = 0;
+		std::size_t allocations = 0;
+		std::size_t pooledAllocations = 0;
+		std::size_t arenaBytes = 0;
+		std::size_t maxBytes = 0;
+		std::size_t failedAllocations = 0;
+	};
+
+	/// <summary>
+	/// Allocator for a worker's lua state.
+	/// Small blocks are recycled through per size class free lists, carved from arenas 
+	/// owned by this object, so most lua allocations bypass the system allocator.
+	/// Memory limits apply only while a task runs, since lua cannot recover from 
+	/// allocation failures outside protected calls. Garbage counts towards the limits 
+	/// until collected, and lua 5.1 does not collect when an allocation fails, 
+	/// so the owner should collect when ShouldCollect returns true.
+	/// Allocate from one thread at a time. Stats can be read from any thread.
+	/// </summary>
+	class LuaAllocator
+	{
+	private:
+
+		/// <summary>
+		/// Size class step, and alignment of pooled blocks
+		/// </summary>
+		static const std::size_t cGranularity = 16;
+
+		/// <summary>
+		/// Number of size classes. Larger blocks use the system allocator.
+		/// </summary>
+		static const std::size_t cClassCount = 32;
+
+		/// <summary>
+		/// Bytes requested from the system per arena
+		/// </summary>
+		static const std::size_t cArenaSize = 64 * 1024;
+
+		const bool mPooled;
+
+		// Max bytes in use while a task runs, or 0
+		const std::size_t mMaxBytes;
+
+		bool mEnforcing;
+		TaskBudget* mTaskBudget;
+		int mUnlimitedDepth;
+
+		// Bytes in use after the last collection while enforcing
+		std::size_t mBytesAfterCollect;
+
+		// Free blocks of each class, linked through their first bytes
+		std::array<void*, cClassCount> mFreeLists;
+
+		// Arenas, linked through their first bytes
+		void* mArenas;
+		char* mArenaNext;
+		std::size_t mArenaLeft;
+
+		std::atomic<std::size_t> mBytesInUse;
+		std::atomic<std::size_t> mPeakBytesInUse;
+		std::atomic<std::size_t> mAllocations;
+		std::atomic<std::size_t> mPooledAllocations;
+		std::atomic<std::size_t> mArenaBytes;
+		std::atomic<std::size_t> mFailedAllocations;
+
+		/// <summary>
+		/// Check whether blocks of a given size come from the pool
+		/// </summary>
+		/// <param name="size">Block size requested</param>
+		/// <returns>True if pooled</returns>
+		bool IsPooled(std::size_t size) const;
+
+		/// <summary>
+		/// Get the size class of a pooled block
+		/// </summary>
+		/// <param name="size">Block size requested</param>
+		/// <returns>Index of the class</returns>
+		static std::size_t ClassOf(std::size_t size);
+
+		/// <summary>
+		/// Take a block for a size class from a new arena, adding the rest of the current arena to the pool
+		/// </summary>
+		/// <param name="classIndex">Class of the block</param>
+		/// <returns>Block, or nullptr if no arena could be allocated</returns>
+		void* CarveBlock(std::size_t classIndex);
+
+		/// <summary>
+		/// Shrink a system allocated block to a pooled size when the pool has no block for it. 
+		/// The new block is placed in a minimal arena of its own, or the old block becomes the arena, 
+		/// so it is freed with the arenas rather than leaked into the pool.
+		/// </summary>
+		/// <param name="ptr">System allocated block</param>
+		/// <param name="osize">Its size</param>
+		/// <param name="nsize">New, pooled size</param>
+		/// <returns>Block to return to lua</returns>
+		void* ShrinkIntoPool(void* ptr, std::size_t osize, std::size_t nsize);
+
+		void* AllocBlock(std::size_t size);
+		void FreeBlock(void* ptr, std::size_t size);
+		void* Resize(void* ptr, std::size_t osize, std::size_t nsize);
+		void* Realloc(void* ptr, std::size_t osize, std::size_t nsize);
+
+		/// <summary>
+		/// Check the limits before growing the bytes in use, and charge the task budget
+		/// </summary>
+		/// <param name="bytes">Growth</param>
+		/// <returns>False if the allocation must fail</returns>
+		bool Reserve(std::size_t bytes);
+
+		/// <summary>
+		/// Credit the task budget for bytes freed, or for a failed reservation
+		/// </summary>
+		/// <param name="bytes">Bytes freed</param>
+		void Release(std::size_t bytes);
+
+		void AddInUse(std::size_t size);
+		void RemoveInUse(std::size_t size);
+
+	public:
+
+		/// <summary>
+		/// Constructor
+		/// </summary>
+		/// <param name="pooled">False to pass every allocation to the system allocator, keeping stats only</param>
+		/// <param name="maxBytes">Max bytes in use while a task runs, or 0</param>
+		explicit LuaAllocator(bool pooled = true, std::size_t maxBytes = 0);
+
+		/// <summary>
+		/// Destructor. Frees all arenas, so close the lua state first.
+		/// </summary>
+		~LuaAllocator();
+
+		LuaAllocator(const LuaAllocator&) = delete;
+		LuaAllocator& operator=(const LuaAllocator&) = delete;
+
+		/// <summary>
+		/// lua_Alloc function, for use with lua_newstate with a LuaAllocator as userdata
+		/// </summary>
+		static void* l_Alloc(void* ud, void* ptr, std::size_t osize, std::size_t nsize);
+
+		/// <summary>
+		/// Free all arenas back to the system, and empty the pool. 
+		/// Call only when no blocks are in use, after closing the lua state.
+		/// </summary>
+		void ReleaseArenas();
+
+		/// <summary>
+		/// Start enforcing limits for a running task.
+		/// </summary>
+		/// <param name="budget">Budget to charge for memory, or nullptr</param>
+		void BeginTask(TaskBudget* budget);
+
+		/// <summary>
+		/// Stop enforcing limits
+		/// </summary>
+		void EndTask();
+
+		/// <summary>
+		/// Check whether a limit is being enforced
+		/// </summary>
+		/// <returns>True while a task with a memory limit, or on a worker with one, runs</returns>
+		bool IsLimited() const;
+
+		/// <summary>
+		/// Check whether garbage should be collected before a limit fails. 
+		/// True once the bytes allocated since the last collection reach the bytes left under a limit.
+		/// </summary>
+		/// <returns>True to collect</returns>
+		bool ShouldCollect() const;
+
+		/// <summary>
+		/// Record that a full collection has run
+		/// </summary>
+		void OnCollected();
+
+		/// <summary>
+		/// Suspends limits on the allocator of a lua state for the lifetime of this object,
+		/// for allocations outside protected calls while a task runs.
+		/// </summary>
+		class UnlimitedScope
+		{
+		private:
+			LuaAllocator* mAllocator;
+
+		public:
+			explicit UnlimitedScope(lua_State* pL);
+			~UnlimitedScope();
+		};
+
+		/// <summary>
+		/// Get current counters
+		/// Can be called from any thread
+		/// </summary>
+		/// <returns>Stats snapshot</returns>
+		AllocatorStats GetStats() const;
+	};
+}
+
+#endif
@@ -0,0 +1,204 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#include "LuaStatePool.h"
+#include "Worker.h"
+#include "InnerLuaState.h"
+#include "LogSection.h"
+#include "LogStack.h"
+
+using namespace LuaWorker;
+
+LuaStatePool::LuaStatePool()
+	: mTargetSize(0),
+	mParked(0),
+	mStarting(0),
+	mUsers(0) {}
+
+//-------------------------------
+// Private methods
+//-------------------------------
+
+void LuaStatePool::ThreadMain(PoolThread* self)
+{
+	LogSection log(std::make_shared<LogStack>(10), "State pool");
+
+	while (true)
+	{
+		std::shared_ptr<Worker> worker;
+		InnerLuaState lua(log);
+
+		try
+		{
+			lua.Open();
+		}
+		catch (const std::exception& ex)
+		{
+			log.Push(ex);
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(mMtx);
+
+			--mStarting;
+
+			if (!lua.IsOpen())
+			{
+				self->done = true;
+				return;
+			}
+
+			++mParked;
+
+			mCv.wait(lock, [this]() { return !mHandoffs.empty() || mParked > mTargetSize; });
+
+			if (mHandoffs.empty())
+			{
+				// Pool shrunk
+				--mParked;
+				self->done = true;
+				return;
+			}
+
+			// mParked already decremented by Adopt
+			worker = std::move(mHandoffs.front());
+			mHandoffs.pop_front();
+
+			Replenish();
+		}
+
+		worker->ThreadMainPooled(lua);
+		worker.reset();
+
+		std::unique_lock<std::mutex> lock(mMtx);
+
+		if (mParked + mStarting >= mTargetSize)
+		{
+			self->done = true;
+			return;
+		}
+
+		++mStarting; // Replace the state used by the worker
+	}
+}
+
+//------
+void LuaStatePool::Replenish()
+{
+	ReapThreads();
+
+	while (mParked + mStarting < mTargetSize)
+	{
+		++mStarting;
+
+		mThreads.emplace_back();
+		PoolThread* entry = &mThreads.back();
+		entry->thread = std::thread(&LuaStatePool::ThreadMain, this, entry);
+	}
+}
+
+//------
+void LuaStatePool::ReapThreads()
+{
+	for (auto it = mThreads.begin(); it != mThreads.end();)
+	{
+		if (it->done)
+		{
+			// Done is set as the thread's last action under the lock
+			if (it->thread.joinable()) it->thread.join();
+			it = mThreads.erase(it);
+		}
+		else ++it;
+	}
+}
+
+//-------------------------------
+// Public methods
+//-------------------------------
+
+LuaStatePool& LuaStatePool::Instance()
+{
+	// Never destroyed: threads may still be parked at process exit
+	static LuaStatePool* sInstance = new LuaStatePool();
+	return *sInstance;
+}
+
+//------
+void LuaStatePool::SetSize(std::size_t size)
+{
+	{
+		std::unique_lock<std::mutex> lock(mMtx);
+
+		mTargetSize = size;
+		Replenish();
+	}
+
+	mCv.notify_all(); // Release excess parked threads
+}
+
+//------
+std::size_t LuaStatePool::GetParkedCount()
+{
+	std::unique_lock<std::mutex> lock(mMtx);
+	return mParked;
+}
+
+//------
+bool LuaStatePool::Adopt(const std::shared_ptr<Worker>& worker)
+{
+	{
+		std::unique_lock<std::mutex> lock(mMtx);
+
+		if (mParked == 0 || worker == nullptr) return false;
+
+		--mParked;
+		mHandoffs.push_back(worker);
+	}
+
+	mCv.notify_all();
+	return true;
+}
+
+//------
+void LuaStatePool::AddUser()
+{
+	std::unique_lock<std::mutex> lock(mMtx);
+	++mUsers;
+}
+
+//------
+void LuaStatePool::RemoveUser()
+{
+	std::list<PoolThread> threads;
+
+	{
+		std::unique_lock<std::mutex> lock(mMtx);
+
+		if (mUsers == 0 || --mUsers > 0) return;
+
+		mTargetSize = 0;
+		threads.splice(threads.end(), mThreads);
+	}
+
+	mCv.notify_all();
+
+	for (PoolThread& entry : threads)
+	{
+		if (entry.thread.joinable()) entry.thread.join();
+	}
+}
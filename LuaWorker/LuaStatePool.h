@@ -0,0 +1,126 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _LUA_STATE_POOL_H_
+#define _LUA_STATE_POOL_H_
+#pragma once
+
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <list>
+#include <deque>
+
+namespace LuaWorker
+{
+	class Worker;
+
+	/// <summary>
+	/// Process-wide pool of threads, each parked with an open lua state (default worker options).
+	/// Starting a worker with default options hands it to a parked thread, rather than starting a thread and lua from cold.
+	/// When that worker stops, its thread opens a fresh state and parks again, unless the pool is already full.
+	/// </summary>
+	class LuaStatePool
+	{
+	private:
+
+		struct PoolThread
+		{
+			std::thread thread;
+			bool done = false;
+		};
+
+		// Stable addresses, as each thread holds a pointer to its entry
+		std::list<PoolThread> mThreads;
+
+		std::deque<std::shared_ptr<Worker>> mHandoffs;
+
+		std::size_t mTargetSize;
+		std::size_t mParked;	// Open and not yet claimed by a handoff
+		std::size_t mStarting;	// Opening a state, to be parked
+		std::size_t mUsers;
+
+		std::mutex mMtx;
+		std::condition_variable mCv;
+
+		LuaStatePool();
+
+		/// <summary>
+		/// Method executed by each pool thread
+		/// </summary>
+		/// <param name="self">Entry for this thread</param>
+		void ThreadMain(PoolThread* self);
+
+		/// <summary>
+		/// Start threads until the target number are parked or starting.
+		/// Call with mMtx held.
+		/// </summary>
+		void Replenish();
+
+		/// <summary>
+		/// Join threads that have exited.
+		/// Call with mMtx held.
+		/// </summary>
+		void ReapThreads();
+
+	public:
+
+		LuaStatePool(const LuaStatePool&) = delete;
+		LuaStatePool& operator=(const LuaStatePool&) = delete;
+
+		/// <summary>
+		/// Get the process-wide instance
+		/// </summary>
+		/// <returns>The pool</returns>
+		static LuaStatePool& Instance();
+
+		/// <summary>
+		/// Set the number of states to keep parked. 0 disables the pool.
+		/// Threads are started, or parked threads released, in the background.
+		/// </summary>
+		/// <param name="size">Number of states</param>
+		void SetSize(std::size_t size);
+
+		/// <summary>
+		/// Get the number of states parked and ready for a worker
+		/// </summary>
+		/// <returns>Number of states</returns>
+		std::size_t GetParkedCount();
+
+		/// <summary>
+		/// Hand a worker to a parked thread, which runs it with its open state.
+		/// </summary>
+		/// <param name="worker">Worker to run</param>
+		/// <returns>False if no state is parked</returns>
+		bool Adopt(const std::shared_ptr<Worker>& worker);
+
+		/// <summary>
+		/// Register a user of the pool (such as a lua state that loaded the library)
+		/// </summary>
+		void AddUser();
+
+		/// <summary>
+		/// Unregister a user of the pool. When the last user is removed, the pool is emptied
+		/// and its threads joined, which waits for any workers still running on them.
+		/// </summary>
+		void RemoveUser();
+	};
+}
+
+#endif
@@ -0,0 +1,134 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#include <algorithm>
+#include <functional>
+
+#include "SharedCache.h"
+
+using namespace LuaWorker;
+
+std::map<std::string, std::shared_ptr<SharedCache>> SharedCache::sCaches;
+std::mutex SharedCache::sCachesMtx;
+
+//------
+SharedCache::SharedCache(std::size_t maxBytes, std::size_t shardCount)
+{
+	shardCount = std::max((std::size_t)1, shardCount);
+
+	for (std::size_t i = 0; i < shardCount; ++i)
+	{
+		mShards.push_back(std::make_unique<Shard>(maxBytes / shardCount));
+	}
+}
+
+//------
+std::shared_ptr<SharedCache> SharedCache::Open(const std::string& name, std::size_t maxBytes, std::size_t shardCount)
+{
+	std::unique_lock<std::mutex> lock(sCachesMtx);
+
+	std::shared_ptr<SharedCache>& pCache = sCaches[name];
+
+	if (pCache == nullptr) pCache = std::make_shared<SharedCache>(maxBytes, shardCount);
+
+	return pCache;
+}
+
+//------
+SharedCache::Shard& SharedCache::ShardFor(const std::string& key)
+{
+	return *mShards[std::hash<std::string>{}(key) % mShards.size()];
+}
+
+//------
+std::unique_lock<std::mutex> SharedCache::Lock(Shard& shard)
+{
+	std::unique_lock<std::mutex> lock(shard.mtx, std::try_to_lock);
+
+	if (!lock.owns_lock())
+	{
+		lock.lock();
+		++shard.contended;
+	}
+
+	++shard.locks;
+
+	return lock;
+}
+
+//------
+bool SharedCache::Get(const std::string& key, std::string& outValue)
+{
+	Shard& shard = ShardFor(key);
+	std::unique_lock<std::mutex> lock = Lock(shard);
+
+	std::string* pValue = shard.cache.Get(key);
+
+	if (pValue == nullptr) return false;
+
+	outValue = *pValue;
+	return true;
+}
+
+//------
+bool SharedCache::Set(const std::string& key, const std::string& value)
+{
+	Shard& shard = ShardFor(key);
+	std::unique_lock<std::mutex> lock = Lock(shard);
+
+	return shard.cache.Set(key, value, key.length() + value.length() + cEntryOverhead);
+}
+
+//------
+bool SharedCache::Remove(const std::string& key)
+{
+	Shard& shard = ShardFor(key);
+	std::unique_lock<std::mutex> lock = Lock(shard);
+
+	return shard.cache.Remove(key);
+}
+
+//------
+void SharedCache::Clear()
+{
+	for (auto& pShard : mShards)
+	{
+		std::unique_lock<std::mutex> lock = Lock(*pShard);
+		pShard->cache.Clear();
+	}
+}
+
+//------
+std::vector<SharedCache::ShardStats> SharedCache::GetStats()
+{
+	std::vector<ShardStats> stats;
+
+	for (auto& pShard : mShards)
+	{
+		std::unique_lock<std::mutex> lock(pShard->mtx);
+
+		ShardStats shardStats;
+		shardStats.cache = pShard->cache.GetStats();
+		shardStats.locks = pShard->locks;
+		shardStats.contended = pShard->contended;
+
+		stats.push_back(shardStats);
+	}
+
+	return stats;
+}
@@ -0,0 +1,156 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _SHARED_CACHE_H_
+#define _SHARED_CACHE_H_
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "LruCache.h"
+
+namespace LuaWorker
+{
+	/// <summary>
+	/// Process-wide key-value cache shared by all lua states, split into shards 
+	/// each with its own lock and LRU eviction within a share of the byte budget.
+	/// Keys and values are serialized strings.
+	/// </summary>
+	class SharedCache
+	{
+	public:
+
+		/// <summary>
+		/// Counters for one shard
+		/// </summary>
+		struct ShardStats
+		{
+			AutoKeyDeck::LruCacheStats cache;	// weight and capacity in bytes
+			std::size_t locks = 0;		// Lock acquisitions
+			std::size_t contended = 0;	// Acquisitions that had to wait for another thread
+		};
+
+		// Approximate bytes used by each entry in addition to its key and value
+		static const std::size_t cEntryOverhead = 64;
+
+		static const std::size_t cDefaultMaxBytes = 16 * 1024 * 1024;
+		static const std::size_t cDefaultShards = 16;
+
+	private:
+
+		struct Shard
+		{
+			std::mutex mtx;
+			AutoKeyDeck::LruCache<std::string, std::string> cache;
+			std::size_t locks = 0;
+			std::size_t contended = 0;
+
+			explicit Shard(std::size_t maxBytes) : cache(maxBytes) {}
+		};
+
+		//-------------------------------
+		// Properties
+		//-------------------------------
+
+		std::vector<std::unique_ptr<Shard>> mShards;
+
+		// Caches by name
+		static std::map<std::string, std::shared_ptr<SharedCache>> sCaches;
+		static std::mutex sCachesMtx;
+
+		//-------------------------------
+		// Private methods
+		//-------------------------------
+
+		/// <summary>
+		/// Get the shard holding a key
+		/// </summary>
+		/// <param name="key">Key</param>
+		/// <returns>Shard</returns>
+		Shard& ShardFor(const std::string& key);
+
+		/// <summary>
+		/// Lock a shard, counting the acquisition
+		/// </summary>
+		/// <param name="shard">Shard to lock</param>
+		/// <returns>Lock held on the shard</returns>
+		static std::unique_lock<std::mutex> Lock(Shard& shard);
+
+	public:
+
+		/// <summary>
+		/// Constructor
+		/// </summary>
+		/// <param name="maxBytes">Byte budget, divided equally between the shards</param>
+		/// <param name="shardCount">Number of shards. At least 1.</param>
+		SharedCache(std::size_t maxBytes, std::size_t shardCount);
+
+		SharedCache(const SharedCache&) = delete;
+		SharedCache& operator=(const SharedCache&) = delete;
+
+		/// <summary>
+		/// Get the cache with the given name, creating it if needed.
+		/// Caches live until the process exits.
+		/// </summary>
+		/// <param name="name">Name of the cache</param>
+		/// <param name="maxBytes">Byte budget if the cache is created</param>
+		/// <param name="shardCount">Number of shards if the cache is created</param>
+		/// <returns>The cache</returns>
+		static std::shared_ptr<SharedCache> Open(const std::string& name, std::size_t maxBytes, std::size_t shardCount);
+
+		/// <summary>
+		/// Copy the value for a key, marking it most recently used in its shard
+		/// </summary>
+		/// <param name="key">Key to find</param>
+		/// <param name="outValue">Set to the value if found</param>
+		/// <returns>True if found</returns>
+		bool Get(const std::string& key, std::string& outValue);
+
+		/// <summary>
+		/// Set the value for a key, evicting least recently used entries in its shard until it fits
+		/// </summary>
+		/// <param name="key">Key to set</param>
+		/// <param name="value">Value to store</param>
+		/// <returns>False if the entry is larger than a shard's budget (and so is not stored)</returns>
+		bool Set(const std::string& key, const std::string& value);
+
+		/// <summary>
+		/// Remove the entry for a key
+		/// </summary>
+		/// <param name="key">Key to remove</param>
+		/// <returns>True if an entry was removed</returns>
+		bool Remove(const std::string& key);
+
+		/// <summary>
+		/// Remove all entries
+		/// </summary>
+		void Clear();
+
+		/// <summary>
+		/// Get the counters of each shard
+		/// </summary>
+		/// <returns>Stats by shard</returns>
+		std::vector<ShardStats> GetStats();
+	};
+}
+
+#endif
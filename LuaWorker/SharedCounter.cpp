@@ -0,0 +1,132 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#include <algorithm>
+
+#include "SharedCounter.h"
+
+using namespace LuaWorker;
+
+std::map<std::string, std::shared_ptr<SharedCounter>> SharedCounter::sCounters;
+std::mutex SharedCounter::sCountersMtx;
+std::atomic<std::size_t> SharedCounter::sNextThreadIndex(0);
+
+//------
+SharedCounter::SharedCounter(std::size_t stripeCount) :
+	mStripeCount(std::min(std::max((std::size_t)1, stripeCount), cMaxStripes))
+{
+	mStripes = std::make_unique<Stripe[]>(mStripeCount);
+}
+
+//------
+std::shared_ptr<SharedCounter> SharedCounter::Open(const std::string& name, std::size_t stripeCount)
+{
+	std::unique_lock<std::mutex> lock(sCountersMtx);
+
+	std::shared_ptr<SharedCounter>& pCounter = sCounters[name];
+
+	if (pCounter == nullptr) pCounter = std::make_shared<SharedCounter>(stripeCount);
+
+	return pCounter;
+}
+
+//------
+SharedCounter::Stripe& SharedCounter::ThreadStripe()
+{
+	if (mStripeCount == 1) return mStripes[0];
+
+	thread_local std::size_t threadIndex = sNextThreadIndex.fetch_add(1, std::memory_order_relaxed);
+
+	return mStripes[threadIndex % mStripeCount];
+}
+
+//------
+void SharedCounter::Add(double n)
+{
+	Stripe& stripe = ThreadStripe();
+
+	// Integers within double precision are summed exactly, without a CAS loop
+	if (n == std::floor(n) && std::fabs(n) < 9007199254740992.0)
+	{
+		stripe.intTotal.fetch_add((std::int64_t)n, std::memory_order_relaxed);
+		return;
+	}
+
+	double current = stripe.floatTotal.load(std::memory_order_relaxed);
+	while (!stripe.floatTotal.compare_exchange_weak(current, current + n, std::memory_order_relaxed));
+}
+
+//------
+void SharedCounter::Observe(double x)
+{
+	Stripe& stripe = ThreadStripe();
+
+	double current = stripe.min.load(std::memory_order_relaxed);
+	while (x < current && !stripe.min.compare_exchange_weak(current, x, std::memory_order_relaxed));
+
+	current = stripe.max.load(std::memory_order_relaxed);
+	while (x > current && !stripe.max.compare_exchange_weak(current, x, std::memory_order_relaxed));
+
+	stripe.observed.fetch_add(1, std::memory_order_release);
+}
+
+//------
+SharedCounter::Value SharedCounter::Read() const
+{
+	Value value;
+	value.min = HUGE_VAL;
+	value.max = -HUGE_VAL;
+
+	std::int64_t intTotal = 0;
+
+	for (std::size_t i = 0; i < mStripeCount; ++i)
+	{
+		const Stripe& stripe = mStripes[i];
+
+		intTotal += stripe.intTotal.load(std::memory_order_relaxed);
+		value.total += stripe.floatTotal.load(std::memory_order_relaxed);
+
+		std::uint64_t observed = stripe.observed.load(std::memory_order_acquire);
+		if (observed == 0) continue;
+
+		value.min = std::min(value.min, stripe.min.load(std::memory_order_relaxed));
+		value.max = std::max(value.max, stripe.max.load(std::memory_order_relaxed));
+		value.observed += observed;
+	}
+
+	value.total += (double)intTotal;
+
+	if (value.observed == 0) value.min = value.max = 0;
+
+	return value;
+}
+
+//------
+void SharedCounter::Reset()
+{
+	for (std::size_t i = 0; i < mStripeCount; ++i)
+	{
+		Stripe& stripe = mStripes[i];
+
+		stripe.intTotal.store(0, std::memory_order_relaxed);
+		stripe.floatTotal.store(0, std::memory_order_relaxed);
+		stripe.observed.store(0, std::memory_order_relaxed);
+		stripe.min.store(HUGE_VAL, std::memory_order_relaxed);
+		stripe.max.store(-HUGE_VAL, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,142 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _SHARED_COUNTER_H_
+#define _SHARED_COUNTER_H_
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace LuaWorker
+{
+	/// <summary>
+	/// Process-wide counter updated atomically from any thread: a running total,
+	/// and the min and max of observed values. Updates can be spread over several
+	/// stripes (each on its own cache line), chosen per thread, so that hot 
+	/// increments from different threads do not contend. Reads sum the stripes.
+	/// </summary>
+	class SharedCounter
+	{
+	public:
+
+		// Assumed cache line size
+		static const std::size_t cCacheLine = 64;
+
+		static const std::size_t cMaxStripes = 64;
+
+		/// <summary>
+		/// Combined value of all stripes
+		/// </summary>
+		struct Value
+		{
+			double total = 0;
+			std::uint64_t observed = 0;	// Number of values observed
+			double min = 0;		// Valid if observed > 0
+			double max = 0;		// Valid if observed > 0
+		};
+
+	private:
+
+		struct alignas(cCacheLine) Stripe
+		{
+			// Integral additions, exact
+			std::atomic<std::int64_t> intTotal{ 0 };
+			// Other additions
+			std::atomic<double> floatTotal{ 0 };
+
+			std::atomic<std::uint64_t> observed{ 0 };
+			std::atomic<double> min{ HUGE_VAL };
+			std::atomic<double> max{ -HUGE_VAL };
+		};
+
+		//-------------------------------
+		// Properties
+		//-------------------------------
+
+		std::unique_ptr<Stripe[]> mStripes;
+		std::size_t mStripeCount;
+
+		// Counters by name
+		static std::map<std::string, std::shared_ptr<SharedCounter>> sCounters;
+		static std::mutex sCountersMtx;
+
+		// Assigns each thread its stripe index
+		static std::atomic<std::size_t> sNextThreadIndex;
+
+		//-------------------------------
+		// Private methods
+		//-------------------------------
+
+		/// <summary>
+		/// Get the stripe for the calling thread
+		/// </summary>
+		/// <returns>Stripe</returns>
+		Stripe& ThreadStripe();
+
+	public:
+
+		/// <summary>
+		/// Constructor
+		/// </summary>
+		/// <param name="stripeCount">Number of stripes, from 1 to cMaxStripes</param>
+		explicit SharedCounter(std::size_t stripeCount);
+
+		SharedCounter(const SharedCounter&) = delete;
+		SharedCounter& operator=(const SharedCounter&) = delete;
+
+		/// <summary>
+		/// Get the counter with the given name, creating it if needed.
+		/// Counters live until the process exits.
+		/// </summary>
+		/// <param name="name">Name of the counter</param>
+		/// <param name="stripeCount">Number of stripes if the counter is created</param>
+		/// <returns>The counter</returns>
+		static std::shared_ptr<SharedCounter> Open(const std::string& name, std::size_t stripeCount);
+
+		/// <summary>
+		/// Add to the total
+		/// </summary>
+		/// <param name="n">Amount to add</param>
+		void Add(double n);
+
+		/// <summary>
+		/// Include a value in the min and max
+		/// </summary>
+		/// <param name="x">Value observed</param>
+		void Observe(double x);
+
+		/// <summary>
+		/// Combine the stripes. Not a consistent snapshot while other threads update the counter.
+		/// </summary>
+		/// <returns>Current value</returns>
+		Value Read() const;
+
+		/// <summary>
+		/// Set the total to zero and forget observed values
+		/// </summary>
+		void Reset();
+	};
+}
+
+#endif
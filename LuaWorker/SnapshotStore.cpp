@@ -0,0 +1,67 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#include "SnapshotStore.h"
+
+using namespace LuaWorker;
+
+std::map<std::string, std::shared_ptr<SnapshotStore>> SnapshotStore::sStores;
+std::mutex SnapshotStore::sStoresMtx;
+
+//------
+SnapshotStore::SnapshotStore() : mCurrent(nullptr), mVersion(0) {}
+
+//------
+std::shared_ptr<SnapshotStore> SnapshotStore::Open(const std::string& name)
+{
+	std::unique_lock<std::mutex> lock(sStoresMtx);
+
+	std::shared_ptr<SnapshotStore>& pStore = sStores[name];
+
+	if (pStore == nullptr) pStore = std::make_shared<SnapshotStore>();
+
+	return pStore;
+}
+
+//------
+std::uint64_t SnapshotStore::Publish(std::string data)
+{
+	std::unique_lock<std::mutex> lock(mPublishMtx);
+
+	std::uint64_t version = mVersion.load(std::memory_order_relaxed) + 1;
+
+	std::shared_ptr<const Snapshot> pSnapshot = std::make_shared<const Snapshot>(Snapshot{ version, std::move(data) });
+
+	// Previous version is freed here, or when its last reader lets go
+	std::atomic_store_explicit(&mCurrent, pSnapshot, std::memory_order_release);
+	mVersion.store(version, std::memory_order_release);
+
+	return version;
+}
+
+//------
+std::uint64_t SnapshotStore::GetVersion() const
+{
+	return mVersion.load(std::memory_order_acquire);
+}
+
+//------
+std::shared_ptr<const SnapshotStore::Snapshot> SnapshotStore::GetCurrent() const
+{
+	return std::atomic_load_explicit(&mCurrent, std::memory_order_acquire);
+}
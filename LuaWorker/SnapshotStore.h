@@ -0,0 +1,105 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _SNAPSHOT_STORE_H_
+#define _SNAPSHOT_STORE_H_
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace LuaWorker
+{
+	/// <summary>
+	/// Process-wide holder of the current version of an immutable serialized value.
+	/// Publishing swaps in a new version atomically; readers check the version without
+	/// locking and only load the value when it has changed. A version is freed once 
+	/// no reader holds it.
+	/// </summary>
+	class SnapshotStore
+	{
+	public:
+
+		/// <summary>
+		/// One published version
+		/// </summary>
+		struct Snapshot
+		{
+			std::uint64_t version;
+			std::string data;
+		};
+
+	private:
+
+		//-------------------------------
+		// Properties
+		//-------------------------------
+
+		std::shared_ptr<const Snapshot> mCurrent;
+
+		// Version of mCurrent, stored after it. 0 before the first publish.
+		std::atomic<std::uint64_t> mVersion;
+
+		// Orders publishers only
+		std::mutex mPublishMtx;
+
+		// Stores by name
+		static std::map<std::string, std::shared_ptr<SnapshotStore>> sStores;
+		static std::mutex sStoresMtx;
+
+	public:
+
+		SnapshotStore();
+
+		SnapshotStore(const SnapshotStore&) = delete;
+		SnapshotStore& operator=(const SnapshotStore&) = delete;
+
+		/// <summary>
+		/// Get the store with the given name, creating it if needed.
+		/// Stores live until the process exits.
+		/// </summary>
+		/// <param name="name">Name of the store</param>
+		/// <returns>The store</returns>
+		static std::shared_ptr<SnapshotStore> Open(const std::string& name);
+
+		/// <summary>
+		/// Make a new value current
+		/// </summary>
+		/// <param name="data">Serialized value</param>
+		/// <returns>Version of the new value</returns>
+		std::uint64_t Publish(std::string data);
+
+		/// <summary>
+		/// Get the current version number, without locking
+		/// </summary>
+		/// <returns>Current version, or 0 if nothing is published</returns>
+		std::uint64_t GetVersion() const;
+
+		/// <summary>
+		/// Get the current version
+		/// </summary>
+		/// <returns>Current snapshot, or nullptr if nothing is published</returns>
+		std::shared_ptr<const Snapshot> GetCurrent() const;
+	};
+}
+
+#endif
@@ -26,6 +26,42 @@ using std::chrono::system_clock;
 using namespace LuaWorker;
 
 
+//-------------------------------
+// Private methods
+//-------------------------------
+
+void Task::NotifyObservers()
+{
+	std::vector<std::shared_ptr<TaskObserver>> observers;
+
+	{
+		std::unique_lock<std::mutex> lock(mObserversMtx);
+
+		if (mObservers.empty()) return;
+
+		for (auto it = mObservers.begin(); it != mObservers.end();)
+		{
+			std::shared_ptr<TaskObserver> observer = it->lock();
+			if (observer == nullptr)
+			{
+				it = mObservers.erase(it);
+				continue;
+			}
+
+			observers.push_back(observer);
+			++it;
+		}
+	}
+
+	std::shared_ptr<Task> self = weak_from_this().lock();
+	if (self == nullptr) return;
+
+	for (const std::shared_ptr<TaskObserver>& observer : observers)
+	{
+		observer->OnTaskUpdated(self);
+	}
+}
+
 //-------------------------------
 // Protected methods
 //-------------------------------
@@ -39,7 +75,7 @@ void Task::SetResult(const std::string& newResult, bool yielded)
 		mUnreadResult = true;
 		mResult = newResult;
 
-		if (mStatus != TaskStatus::Error)
+		if (!IsFinal(mStatus))
 		{
 			if (yielded)
 			{
@@ -49,6 +85,18 @@ void Task::SetResult(const std::string& newResult, bool yielded)
 		}
 	}
 
+	mResultStatusCv.notify_all();
+	NotifyObservers();
+}
+
+void Task::SetSuspended()
+{
+	{
+		std::unique_lock<std::mutex> lock(mResultStatusMtx);
+
+		if (mStatus == TaskStatus::Running) mStatus = TaskStatus::Suspended;
+	}
+
 	mResultStatusCv.notify_all();
 }
 
@@ -109,6 +157,26 @@ std::string Task::GetResult()
 	}
 }
 
+//------
+void Task::Emit(const std::string& item)
+{
+	std::unique_lock<std::mutex> lock(mResultStatusMtx);
+	mEmitted.push_back(item);
+}
+
+//------
+std::deque<std::string> Task::DrainEmitted()
+{
+	std::deque<std::string> out;
+
+	{
+		std::unique_lock<std::mutex> lock(mResultStatusMtx);
+		out.swap(mEmitted);
+	}
+
+	return out;
+}
+
 //------
 bool Task::WaitForResult(unsigned int waitForMillis)
 {
@@ -139,7 +207,54 @@ TaskStatus Task::GetStatus()
 
 
 //------
-Task::Task() : mStatus(TaskStatus::NotStarted), mUnreadResult(false) {}
+bool Task::IsCancelled() const
+{
+	return mCancelled;
+}
+
+//------
+bool Task::IsResultReady()
+{
+	std::unique_lock<std::mutex> lock(mResultStatusMtx);
+
+	return IsFinal(mStatus) || mUnreadResult;
+}
+
+//------
+void Task::SetBudget(const TaskBudget& budget)
+{
+	mBudget = budget;
+}
+
+//------
+TaskBudget& Task::GetBudget()
+{
+	return mBudget;
+}
+
+//------
+void Task::AddObserver(const std::weak_ptr<TaskObserver>& observer)
+{
+	std::unique_lock<std::mutex> lock(mObserversMtx);
+
+	mObservers.push_back(observer);
+}
+
+//------
+void Task::RemoveObserver(const TaskObserver* observer)
+{
+	std::unique_lock<std::mutex> lock(mObserversMtx);
+
+	for (auto it = mObservers.begin(); it != mObservers.end();)
+	{
+		std::shared_ptr<TaskObserver> current = it->lock();
+		if (current == nullptr || current.get() == observer) it = mObservers.erase(it);
+		else ++it;
+	}
+}
+
+//------
+Task::Task() : mStatus(TaskStatus::NotStarted), mUnreadResult(false), mCancelled(false) {}
 
 
 
@@ -149,10 +264,12 @@ void Task::SetError(const std::string& errMsg)
 	{
 		std::unique_lock<std::mutex> lock(mResultStatusMtx);
 
+		if (mStatus == TaskStatus::Cancelled) return; // Errors from interrupting a cancelled task
 		if(mStatus != TaskStatus::Error) mError = errMsg; // Keep first error
 		mStatus = TaskStatus::Error;
 	}
 	mResultStatusCv.notify_all();
+	NotifyObservers();
 }
 
 //------
@@ -171,7 +288,10 @@ void Task::Cancel()
 	{
 		std::unique_lock<std::mutex> lock(mResultStatusMtx);
 
-		if (!IsFinal(mStatus)) mStatus = TaskStatus::Cancelled;
+		if (IsFinal(mStatus)) return;
+		mStatus = TaskStatus::Cancelled;
+		mCancelled = true;
 	}
 	mResultStatusCv.notify_all();
+	NotifyObservers();
 }
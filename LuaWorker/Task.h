@@ -25,8 +25,14 @@
 //#include <thread>
 #include <mutex>
 #include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
 
 #include "Cancelable.h"
+#include "TaskObserver.h"
+#include "TaskBudget.h"
 
 extern "C" {
 #include "lua.h"
@@ -49,7 +55,7 @@ namespace LuaWorker
 	/// <summary>
 	/// Base class for tasks for LuaWorker to execute
 	/// </summary>
-	class Task : public Cancelable
+	class Task : public Cancelable, public std::enable_shared_from_this<Task>
 	{
 	private:
 
@@ -62,11 +68,31 @@ namespace LuaWorker
 		std::string mResult;
 		std::string mError;
 
+		std::deque<std::string> mEmitted;
+
 		std::mutex mResultStatusMtx;
 		std::condition_variable mResultStatusCv;
 
 		bool mUnreadResult;
 
+		// Mirrors Cancelled status, readable without locking (e.g. from the lua hook)
+		std::atomic<bool> mCancelled;
+
+		std::vector<std::weak_ptr<TaskObserver>> mObservers;
+		std::mutex mObserversMtx;
+
+		// Set before queueing, then used in the worker thread only
+		TaskBudget mBudget;
+
+		//-------------------------------
+		// Private methods
+		//-------------------------------
+
+		/// <summary>
+		/// Notify observers of a new result or status
+		/// </summary>
+		void NotifyObservers();
+
 	protected:
 
 		//-------------------------------
@@ -79,6 +105,11 @@ namespace LuaWorker
 		/// <param name="newResult">Value of the result to set</param>
 		void SetResult(const std::string& newResult, bool yielded);
 
+		/// <summary>
+		/// Set a running task to suspended status, without setting a result
+		/// </summary>
+		void SetSuspended();
+
 		/// <summary>
 		/// Try to set the task to a running status.
 		/// </summary>
@@ -118,6 +149,18 @@ namespace LuaWorker
 		/// <returns>Task result</returns>
 		std::string GetResult();
 
+		/// <summary>
+		/// Queue a partial result for the caller, without changing the task status
+		/// </summary>
+		/// <param name="item">Value to queue</param>
+		void Emit(const std::string& item);
+
+		/// <summary>
+		/// Remove and return all partial results emitted so far (oldest first)
+		/// </summary>
+		/// <returns>Emitted items</returns>
+		std::deque<std::string> DrainEmitted();
+
 		/// <summary>
 		/// Block until task has executed (or reaches a final state) 
 		/// </summary>
@@ -131,6 +174,43 @@ namespace LuaWorker
 		/// <returns>Current status</returns>
 		TaskStatus GetStatus();
 
+		/// <summary>
+		/// Check whether Cancel has been called on this task, without locking
+		/// </summary>
+		/// <returns>True if cancelled</returns>
+		bool IsCancelled() const;
+
+		/// <summary>
+		/// Check whether WaitForResult would return immediately
+		/// </summary>
+		/// <returns>True if the task is final, or has a result not yet read</returns>
+		bool IsResultReady();
+
+		/// <summary>
+		/// Limit execution of this task. Call before adding the task to a worker.
+		/// </summary>
+		/// <param name="budget">Budget to apply</param>
+		void SetBudget(const TaskBudget& budget);
+
+		/// <summary>
+		/// Get execution budget of this task
+		/// Call in worker thread only.
+		/// </summary>
+		/// <returns>The budget</returns>
+		TaskBudget& GetBudget();
+
+		/// <summary>
+		/// Register an observer to be notified of new results and final statuses
+		/// </summary>
+		/// <param name="observer">Observer to add</param>
+		void AddObserver(const std::weak_ptr<TaskObserver>& observer);
+
+		/// <summary>
+		/// Unregister an observer
+		/// </summary>
+		/// <param name="observer">Observer to remove</param>
+		void RemoveObserver(const TaskObserver* observer);
+
 
 		/// <summary>
 		/// Permanently cancel execution and any pending tasks
@@ -0,0 +1,108 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#include <algorithm>
+#include <cstdint>
+
+#include "TaskBudget.h"
+
+using namespace LuaWorker;
+using std::chrono::steady_clock;
+
+//------
+TaskBudget::TaskBudget(unsigned long maxMillis, unsigned long maxInstructions, std::size_t maxMemory) 
+	: mMaxMillis(maxMillis), 
+	mMaxInstructions(maxInstructions),
+	mMaxMemory(maxMemory),
+	mUsedTime(steady_clock::duration::zero()),
+	mUsedInstructions(0),
+	mUsedMemory(0),
+	mStartedAt() {}
+
+//------
+bool TaskBudget::IsLimited() const
+{
+	return mMaxMillis > 0 || mMaxInstructions > 0;
+}
+
+//------
+bool TaskBudget::HasMemoryLimit() const
+{
+	return mMaxMemory > 0;
+}
+
+//------
+bool TaskBudget::ReserveMemory(std::size_t bytes)
+{
+	if (bytes > GetMemoryLeft()) return false;
+
+	mUsedMemory += bytes;
+	return true;
+}
+
+//------
+std::size_t TaskBudget::GetMemoryLeft() const
+{
+	if (mMaxMemory == 0) return SIZE_MAX;
+
+	return mMaxMemory - std::min(mUsedMemory, mMaxMemory);
+}
+
+//------
+void TaskBudget::ReleaseMemory(std::size_t bytes)
+{
+	mUsedMemory -= std::min(mUsedMemory, bytes);
+}
+
+//------
+void TaskBudget::Start()
+{
+	mStartedAt = steady_clock::now();
+}
+
+//------
+void TaskBudget::Stop()
+{
+	mUsedTime += steady_clock::now() - mStartedAt;
+}
+
+//------
+bool TaskBudget::Charge(unsigned long instructions)
+{
+	mUsedInstructions += instructions;
+
+	if (mMaxInstructions > 0 && mUsedInstructions >= mMaxInstructions) return false;
+
+	if (mMaxMillis > 0 && 
+		mUsedTime + (steady_clock::now() - mStartedAt) >= std::chrono::milliseconds(mMaxMillis)) return false;
+
+	return true;
+}
+
+//------
+int TaskBudget::GetCheckInterval() const
+{
+	unsigned long long interval = cCheckInterval;
+
+	if (mMaxInstructions > 0 && mUsedInstructions < mMaxInstructions)
+	{
+		interval = std::min(interval, mMaxInstructions - mUsedInstructions);
+	}
+
+	return (int)interval;
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _TASK_BUDGET_H_
+#define _TASK_BUDGET_H_
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+namespace LuaWorker
+{
+	/// <summary>
+	/// Limits on the execution time, lua instructions and memory used by a task,
+	/// summed over all resumes. Zero means unlimited.
+	/// Memory used includes garbage the task has made, until it is collected.
+	/// Usage is tracked in the worker thread only.
+	/// </summary>
+	class TaskBudget
+	{
+	private:
+
+		/// <summary>
+		/// Max instructions between budget checks
+		/// </summary>
+		static const unsigned long cCheckInterval = 1000;
+
+		unsigned long mMaxMillis;
+		unsigned long mMaxInstructions;
+		std::size_t mMaxMemory;
+
+		std::chrono::steady_clock::duration mUsedTime;
+		unsigned long long mUsedInstructions;
+		std::size_t mUsedMemory;
+
+		std::chrono::steady_clock::time_point mStartedAt;
+
+	public:
+
+		/// <summary>
+		/// Constructor
+		/// </summary>
+		/// <param name="maxMillis">Max execution time (ms), or 0</param>
+		/// <param name="maxInstructions">Max lua instructions, or 0</param>
+		/// <param name="maxMemory">Max bytes allocated and not freed by the task, or 0</param>
+		TaskBudget(unsigned long maxMillis = 0, unsigned long maxInstructions = 0, std::size_t maxMemory = 0);
+
+		/// <summary>
+		/// Check whether a time or instruction limit is set
+		/// </summary>
+		/// <returns>True if limited</returns>
+		bool IsLimited() const;
+
+		/// <summary>
+		/// Check whether a memory limit is set
+		/// </summary>
+		/// <returns>True if limited</returns>
+		bool HasMemoryLimit() const;
+
+		/// <summary>
+		/// Count bytes allocated by the task, if within the memory limit
+		/// </summary>
+		/// <param name="bytes">Bytes to allocate</param>
+		/// <returns>False if the limit would be exceeded</returns>
+		bool ReserveMemory(std::size_t bytes);
+
+		/// <summary>
+		/// Get the bytes the task may still allocate
+		/// </summary>
+		/// <returns>Bytes left, or SIZE_MAX if unlimited</returns>
+		std::size_t GetMemoryLeft() const;
+
+		/// <summary>
+		/// Count bytes freed while the task runs. 
+		/// Usage never drops below zero, so freeing other tasks' garbage earns no credit.
+		/// </summary>
+		/// <param name="bytes">Bytes freed</param>
+		void ReleaseMemory(std::size_t bytes);
+
+		/// <summary>
+		/// Begin timing a period of execution
+		/// </summary>
+		void Start();
+
+		/// <summary>
+		/// End timing a period of execution
+		/// </summary>
+		void Stop();
+
+		/// <summary>
+		/// Add instructions executed since the last charge, and check limits
+		/// </summary>
+		/// <param name="instructions">Instructions executed</param>
+		/// <returns>False if the budget is exceeded</returns>
+		bool Charge(unsigned long instructions);
+
+		/// <summary>
+		/// Get the number of instructions to run before the next call to Charge
+		/// </summary>
+		/// <returns>Count for the lua count hook</returns>
+		int GetCheckInterval() const;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,96 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#include "TaskCompletionQueue.h"
+
+using namespace LuaWorker;
+
+//------
+CompletionSignal& TaskCompletionQueue::GetSignal()
+{
+	if (mSignal == nullptr)
+	{
+		mSignal = std::make_unique<CompletionSignal>();
+		if (!mQueue.empty()) mSignal->Set();
+	}
+
+	return *mSignal;
+}
+
+//------
+std::vector<std::shared_ptr<Task>> TaskCompletionQueue::Poll(std::size_t maxCount)
+{
+	std::vector<std::shared_ptr<Task>> ret;
+
+	std::unique_lock<std::mutex> lock(mMtx);
+
+	while (!mQueue.empty() && ret.size() < maxCount)
+	{
+		std::shared_ptr<Task> task = mQueue.front().lock();
+		mQueued.erase(mQueue.front());
+		mQueue.pop_front();
+
+		if (task != nullptr) ret.push_back(task);
+	}
+
+	if (mSignal != nullptr)
+	{
+		// Re-signal after a partial poll, in case the host consumed the signal before polling
+		if (mQueue.empty()) mSignal->Reset();
+		else mSignal->Set();
+	}
+
+	return ret;
+}
+
+//------
+std::size_t TaskCompletionQueue::Size()
+{
+	std::unique_lock<std::mutex> lock(mMtx);
+
+	return mQueue.size();
+}
+
+//------
+CompletionSignal::NativeHandle TaskCompletionQueue::GetSignalHandle()
+{
+	std::unique_lock<std::mutex> lock(mMtx);
+
+	return GetSignal().GetNativeHandle();
+}
+
+//------
+bool TaskCompletionQueue::HasSignalHandle()
+{
+	std::unique_lock<std::mutex> lock(mMtx);
+
+	return GetSignal().IsValid();
+}
+
+//------
+void TaskCompletionQueue::OnTaskUpdated(const std::shared_ptr<Task>& task)
+{
+	std::unique_lock<std::mutex> lock(mMtx);
+
+	if (!mQueued.insert(task).second) return;
+
+	mQueue.push_back(task);
+
+	// Coalesced: signal only when the queue becomes non-empty
+	if (mSignal != nullptr && mQueue.size() == 1) mSignal->Set();
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _TASK_COMPLETION_QUEUE_H_
+#define _TASK_COMPLETION_QUEUE_H_
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <set>
+#include <memory>
+
+#include "Task.h"
+#include "TaskObserver.h"
+#include "CompletionSignal.h"
+
+namespace LuaWorker
+{
+	/// <summary>
+	/// Queue of tasks which have set a result or reached a final state since last polled.
+	/// Each task is queued at most once until polled.
+	/// Optionally sets an OS signal while the queue is not empty.
+	/// </summary>
+	class TaskCompletionQueue : public TaskObserver
+	{
+	private:
+
+		std::deque<std::weak_ptr<Task>> mQueue;
+		std::set<std::weak_ptr<Task>, std::owner_less<std::weak_ptr<Task>>> mQueued;
+		std::mutex mMtx;
+
+		// Created on first request for the handle
+		std::unique_ptr<CompletionSignal> mSignal;
+
+		/// <summary>
+		/// Get the signal, creating it if needed. Call with mMtx held.
+		/// </summary>
+		/// <returns>The signal</returns>
+		CompletionSignal& GetSignal();
+
+	public:
+
+		/// <summary>
+		/// Remove up to maxCount tasks from the front of the queue
+		/// </summary>
+		/// <param name="maxCount">Max number of tasks to return</param>
+		/// <returns>Tasks in the order they became ready</returns>
+		std::vector<std::shared_ptr<Task>> Poll(std::size_t maxCount);
+
+		/// <summary>
+		/// Get number of tasks queued
+		/// </summary>
+		/// <returns>Queue length</returns>
+		std::size_t Size();
+
+		/// <summary>
+		/// Get an OS handle which is signalled while the queue is not empty
+		/// </summary>
+		/// <returns>The handle (file descriptor on Linux)</returns>
+		CompletionSignal::NativeHandle GetSignalHandle();
+
+		/// <summary>
+		/// Check whether OS signalling is supported on this platform
+		/// </summary>
+		/// <returns>True if supported</returns>
+		bool HasSignalHandle();
+
+		//-------------------------------
+		// TaskObserver
+		//-------------------------------
+
+		void OnTaskUpdated(const std::shared_ptr<Task>& task) override;
+	};
+};
+#endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _TASKDOINIT_H_
+#define _TASKDOINIT_H_
+#pragma once
+
+#include<string>
+#include<vector>
+
+#include "OneShotTask.h"
+
+extern "C" {
+#include "lua.h"
+	//#include "lauxlib.h"
+	//#include "lualib.h"
+}
+
+namespace LuaWorker
+{
+	/// <summary>
+	/// Implementation of Task that prepares a new worker state: requires a list of modules, 
+	/// then executes an initialization string. Completes when the worker is ready for other tasks.
+	/// </summary>
+	class TaskDoInit : public OneShotTask
+	{
+	private:
+
+		std::vector<std::string> mPreload;
+		std::string mInitString;
+
+	protected:
+
+		/// <summary>
+		/// Do the lua work for this task
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns> Result of the initialization string</returns>
+		std::string DoExec(lua_State* pL) override;
+
+	public:
+
+		/// <summary>
+		/// Constructor
+		/// </summary>
+		/// <param name="preload">Names of modules to require, in order</param>
+		/// <param name="initString">Lua string to run after the modules are loaded. May be empty.</param>
+		TaskDoInit(const std::vector<std::string>& preload, const std::string& initString);
+	};
+};
+#endif
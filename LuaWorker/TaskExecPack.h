@@ -88,6 +88,12 @@ namespace LuaWorker
 		/// <returns>Current status</returns>
 		virtual TaskStatus GetStatus() = 0;
 
+		/// <summary>
+		/// Get the task managed by this pack
+		/// </summary>
+		/// <returns>The task</returns>
+		virtual Task* GetBaseTask() = 0;
+
 		/// <summary>
 		/// Permanently cancel execution and any pending tasks
 		/// </summary>
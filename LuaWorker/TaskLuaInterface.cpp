@@ -16,12 +16,21 @@
 *
 \*****************************************************************************/
 
+#include <algorithm>
+#include <chrono>
+#include <new>
+
 #include "TaskLuaInterface.h"
+#include "TaskWaiter.h"
 
 using namespace LuaWorker;
 using namespace AutoKeyDeck;
+using std::chrono::system_clock;
 
 AutoKeyMap<int, Task> TaskLuaInterface::sTasks(0);
+char TaskLuaInterface::sHandleCacheKey = 0;
+char TaskLuaInterface::sCallbacksKey = 0;
+char TaskLuaInterface::sDispatchQueueKey = 0;
 
 //-------------------------------
 // Static Lua helper methods
@@ -49,6 +58,308 @@ std::shared_ptr<Task> TaskLuaInterface::l_PopTask(lua_State* pL, int &outKey)
 	}
 }
 
+std::shared_ptr<Task> TaskLuaInterface::l_ToTask(lua_State* pL, int index)
+{
+	if (!lua_istable(pL, index)) return nullptr;
+
+	// Identify the handle by its destructor closure, which carries the task key
+	lua_getfield(pL, index, "destructor");
+	if (!lua_getmetatable(pL, -1))
+	{
+		lua_pop(pL, 1);
+		return nullptr;
+	}
+	lua_getfield(pL, -1, "__gc");
+
+	std::shared_ptr<Task> pTask = nullptr;
+
+	if (lua_tocfunction(pL, -1) == l_Task_Delete && lua_getupvalue(pL, -1, 1) != nullptr)
+	{
+		if (lua_isnumber(pL, -1))
+		{
+			try
+			{
+				pTask = sTasks.at((int)lua_tointeger(pL, -1));
+			}
+			catch (std::out_of_range) {}
+		}
+		lua_pop(pL, 1);
+	}
+
+	lua_pop(pL, 3);
+	return pTask;
+}
+
+void TaskLuaInterface::l_PushHandleCache(lua_State* pL)
+{
+	lua_pushlightuserdata(pL, &sHandleCacheKey);
+	lua_rawget(pL, LUA_REGISTRYINDEX);
+
+	if (lua_istable(pL, -1)) return;
+
+	lua_pop(pL, 1);
+	lua_newtable(pL);
+		lua_createtable(pL, 0, 1);
+			lua_pushstring(pL, "v");
+		lua_setfield(pL, -2, "__mode");
+	lua_setmetatable(pL, -2);
+
+	lua_pushlightuserdata(pL, &sHandleCacheKey);
+	lua_pushvalue(pL, -2);
+	lua_rawset(pL, LUA_REGISTRYINDEX);
+}
+
+void TaskLuaInterface::l_PushCallbacks(lua_State* pL)
+{
+	lua_pushlightuserdata(pL, &sCallbacksKey);
+	lua_rawget(pL, LUA_REGISTRYINDEX);
+
+	if (lua_istable(pL, -1)) return;
+
+	lua_pop(pL, 1);
+	lua_newtable(pL);
+
+	lua_pushlightuserdata(pL, &sCallbacksKey);
+	lua_pushvalue(pL, -2);
+	lua_rawset(pL, LUA_REGISTRYINDEX);
+}
+
+void TaskLuaInterface::l_PushCallbackEntry(lua_State* pL, std::shared_ptr<Task> pTask)
+{
+	// Entry holds the handle, so callbacks fire even if the caller drops it
+	l_PushCallbacks(pL);
+		lua_pushlightuserdata(pL, pTask.get());
+	lua_rawget(pL, -2);
+
+	if (lua_istable(pL, -1))
+	{
+		lua_remove(pL, -2);
+		return;
+	}
+
+	lua_pop(pL, 1);
+	lua_createtable(pL, 0, 4);
+		l_PushTaskHandle(pL, pTask);
+	lua_setfield(pL, -2, "task");
+
+	lua_pushlightuserdata(pL, pTask.get());
+	lua_pushvalue(pL, -2);
+	lua_rawset(pL, -4);
+	lua_remove(pL, -2);
+
+	pTask->AddObserver(l_GetDispatchQueue(pL));
+}
+
+std::shared_ptr<TaskCompletionQueue> TaskLuaInterface::l_GetDispatchQueue(lua_State* pL)
+{
+	lua_pushlightuserdata(pL, &sDispatchQueueKey);
+	lua_rawget(pL, LUA_REGISTRYINDEX);
+
+	std::shared_ptr<TaskCompletionQueue>* ppQueue = (std::shared_ptr<TaskCompletionQueue>*)lua_touserdata(pL, -1);
+	lua_pop(pL, 1);
+
+	if (ppQueue != nullptr) return *ppQueue;
+
+	void* pMem = lua_newuserdata(pL, sizeof(std::shared_ptr<TaskCompletionQueue>));
+	ppQueue = new (pMem) std::shared_ptr<TaskCompletionQueue>(std::make_shared<TaskCompletionQueue>());
+		lua_createtable(pL, 0, 1);
+			lua_pushcfunction(pL, l_DispatchQueue_Delete);
+		lua_setfield(pL, -2, "__gc");
+	lua_setmetatable(pL, -2);
+
+	lua_pushlightuserdata(pL, &sDispatchQueueKey);
+	lua_pushvalue(pL, -2);
+	lua_rawset(pL, LUA_REGISTRYINDEX);
+	lua_pop(pL, 1);
+
+	return *ppQueue;
+}
+
+int TaskLuaInterface::l_DispatchQueue_Delete(lua_State* pL)
+{
+	std::shared_ptr<TaskCompletionQueue>* ppQueue = (std::shared_ptr<TaskCompletionQueue>*)lua_touserdata(pL, 1);
+
+	if (ppQueue != nullptr) ppQueue->~shared_ptr();
+
+	return 0;
+}
+
+int TaskLuaInterface::l_SetCallback(lua_State* pL, const char* field)
+{
+	if (!lua_isfunction(pL, 2))
+	{
+		luaL_error(pL, "Callback function required!");
+		return 0;
+	}
+
+	std::shared_ptr<Task> pTask = l_PopTask(pL);
+
+	if (pTask == nullptr) return 0;
+
+	l_PushCallbackEntry(pL, pTask);
+		lua_pushvalue(pL, 2);
+	lua_setfield(pL, -2, field);
+	lua_getfield(pL, -1, "task");
+	lua_remove(pL, -2);
+
+	// Catch up on updates before the observer was added
+	if (pTask->IsResultReady()) l_GetDispatchQueue(pL)->OnTaskUpdated(pTask);
+
+	return 1;
+}
+
+bool TaskLuaInterface::l_DispatchCallback(lua_State* pL, std::shared_ptr<Task> pTask)
+{
+	int top = lua_gettop(pL);
+	int entry = top + 2, result = top + 3, err = top + 4;
+
+	l_PushCallbacks(pL);
+		lua_pushlightuserdata(pL, pTask.get());
+	lua_rawget(pL, -2);
+
+	if (!lua_istable(pL, -1))
+	{
+		lua_settop(pL, top);
+		return true;
+	}
+
+	TaskStatus status = pTask->GetStatus();
+	bool final = Task::IsFinal(status);
+
+	// Result already read by the caller
+	if (!final && !pTask->IsResultReady())
+	{
+		lua_settop(pL, top);
+		return true;
+	}
+
+	if (final)
+	{
+		// Final dispatch releases the entry, even if a callback fails
+		lua_pushlightuserdata(pL, pTask.get());
+		lua_pushnil(pL);
+		lua_rawset(pL, -4);
+	}
+
+	// Read the result once for all waiters and callbacks
+	bool hasResult = !final || status == TaskStatus::Complete;
+	if (hasResult)
+	{
+		std::string resultStr = pTask->GetResult();
+		lua_pushlstring(pL, resultStr.data(), resultStr.size());
+	}
+	else lua_pushnil(pL);
+
+	lua_pushnil(pL); // First error raised
+	bool ok = true;
+
+	// Resume coroutines suspended in AwaitAsync
+	lua_getfield(pL, entry, "waiters");
+	if (lua_istable(pL, -1))
+	{
+		// Detach first, so resumed coroutines can await again
+		lua_pushnil(pL);
+		lua_setfield(pL, entry, "waiters");
+
+		int n = (int)lua_objlen(pL, -1);
+		for (int i = 1; i <= n; ++i)
+		{
+			lua_rawgeti(pL, -1, i);
+			lua_State* pCo = lua_tothread(pL, -1);
+			lua_pop(pL, 1);
+
+			if (pCo == nullptr || lua_status(pCo) != LUA_YIELD) continue;
+
+			int nArgs = 0;
+			if (hasResult)
+			{
+				lua_pushvalue(pL, result);
+				lua_xmove(pL, pCo, 1);
+				nArgs = 1;
+			}
+
+			int res = lua_resume(pCo, nArgs);
+			if (res != 0 && res != LUA_YIELD && ok)
+			{
+				lua_xmove(pCo, pL, 1);
+				lua_replace(pL, err);
+				ok = false;
+			}
+		}
+	}
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, entry, final ? "complete" : "yield");
+	if (lua_isfunction(pL, -1))
+	{
+		lua_pushvalue(pL, result);
+		lua_getfield(pL, entry, "task");
+
+		if (lua_pcall(pL, 2, 0, 0) != 0)
+		{
+			if (ok) lua_replace(pL, err);
+			else lua_pop(pL, 1);
+			ok = false;
+		}
+	}
+	else lua_pop(pL, 1);
+
+	if (!ok)
+	{
+		lua_replace(pL, top + 1);
+		lua_settop(pL, top + 1);
+		return false;
+	}
+
+	lua_settop(pL, top);
+	return true;
+}
+
+int TaskLuaInterface::l_AwaitMany(lua_State* pL, bool all)
+{
+	if (!lua_istable(pL, 1))
+	{
+		luaL_error(pL, "Table of tasks required!");
+		return 0;
+	}
+	if (!lua_isnumber(pL, 2))
+	{
+		luaL_error(pL, "Wait millis required!");
+		return 0;
+	}
+
+	long waitMillis = std::max(0L, (long)lua_tointeger(pL, 2));
+
+	std::vector<std::shared_ptr<Task>> tasks;
+	std::vector<int> handleIndices;
+
+	int n = (int)lua_objlen(pL, 1);
+	for (int i = 1; i <= n; ++i)
+	{
+		lua_rawgeti(pL, 1, i);
+		std::shared_ptr<Task> pTask = l_ToTask(pL, -1);
+		lua_pop(pL, 1);
+
+		if (pTask == nullptr) continue;
+
+		tasks.push_back(pTask);
+		handleIndices.push_back(i);
+	}
+
+	std::vector<std::size_t> ready = TaskWaiter::WaitFor(tasks, all, (unsigned int)waitMillis);
+
+	lua_createtable(pL, (int)ready.size(), 0);
+
+	int i = 1;
+	for (std::size_t readyIndex : ready)
+	{
+		lua_rawgeti(pL, 1, handleIndices[readyIndex]);
+		lua_rawseti(pL, -2, i++);
+	}
+
+	return 1;
+}
+
 //-------------------------------
 // Public Static Methods
 //-------------------------------
@@ -74,10 +385,50 @@ int TaskLuaInterface::l_PushTask(lua_State* pL, std::shared_ptr<Task> pTask)
 		lua_pushinteger(pL, key);
 		lua_pushcclosure(pL, l_Task_Finalized, 1);
 	lua_setfield(pL, -2, "Finalized");
+		lua_pushinteger(pL, key);
+		lua_pushcclosure(pL, l_Task_Drain, 1);
+	lua_setfield(pL, -2, "Drain");
+		lua_pushinteger(pL, key);
+		lua_pushcclosure(pL, l_Task_Write, 1);
+	lua_setfield(pL, -2, "Write");
+		lua_pushinteger(pL, key);
+		lua_pushcclosure(pL, l_Task_CloseInput, 1);
+	lua_setfield(pL, -2, "CloseInput");
+		lua_pushinteger(pL, key);
+		lua_pushcclosure(pL, l_Task_OnComplete, 1);
+	lua_setfield(pL, -2, "OnComplete");
+		lua_pushinteger(pL, key);
+		lua_pushcclosure(pL, l_Task_OnYield, 1);
+	lua_setfield(pL, -2, "OnYield");
+		lua_pushinteger(pL, key);
+		lua_pushcclosure(pL, l_Task_AwaitAsync, 1);
+	lua_setfield(pL, -2, "AwaitAsync");
+		lua_pushinteger(pL, key);
+		lua_pushcclosure(pL, l_Task_Cancel, 1);
+	lua_setfield(pL, -2, "Cancel");
+
+	l_PushHandleCache(pL);
+		lua_pushlightuserdata(pL, pTask.get());
+		lua_pushvalue(pL, -3);
+	lua_rawset(pL, -3);
+	lua_pop(pL, 1);
 
 	return 1;
 }
 
+int TaskLuaInterface::l_PushTaskHandle(lua_State* pL, std::shared_ptr<Task> pTask)
+{
+	l_PushHandleCache(pL);
+		lua_pushlightuserdata(pL, pTask.get());
+	lua_rawget(pL, -2);
+	lua_remove(pL, -2);
+
+	if (l_ToTask(pL, -1) == pTask) return 1;
+
+	lua_pop(pL, 1);
+	return l_PushTask(pL, pTask);
+}
+
 
 //-------------------------------
 // Private methods
@@ -125,6 +476,15 @@ int TaskLuaInterface::l_Task_Await(lua_State* pL)
 	return 0;
 }
 
+int TaskLuaInterface::l_Task_Cancel(lua_State* pL)
+{
+	std::shared_ptr<Task> pTask = l_PopTask(pL);
+
+	if (pTask != nullptr) pTask->Cancel();
+
+	return 0;
+}
+
 int TaskLuaInterface::l_Task_Status(lua_State* pL)
 {
 	std::shared_ptr<Task> pTask = l_PopTask(pL);
@@ -169,3 +529,161 @@ int TaskLuaInterface::l_Task_Finalized(lua_State* pL)
 	return 0;
 }
 
+int TaskLuaInterface::l_Task_Drain(lua_State* pL)
+{
+	std::shared_ptr<Task> pTask = l_PopTask(pL);
+
+	if (pTask != nullptr)
+	{
+		std::deque<std::string> items = pTask->DrainEmitted();
+
+		lua_createtable(pL, (int)items.size(), 0);
+
+		int i = 1;
+		for (const std::string& item : items)
+		{
+			lua_pushlstring(pL, item.data(), item.size());
+			lua_rawseti(pL, -2, i++);
+		}
+
+		return 1;
+	}
+
+	return 0;
+}
+
+int TaskLuaInterface::l_Task_Write(lua_State* pL)
+{
+	std::shared_ptr<CoTask> pTask = std::dynamic_pointer_cast<CoTask>(l_PopTask(pL));
+
+	if (pTask != nullptr)
+	{
+		if (!lua_isstring(pL, 2))
+		{
+			luaL_error(pL, "Input chunk required!");
+			return 0;
+		}
+
+		size_t len = 0;
+		const char* chunk = lua_tolstring(pL, 2, &len);
+
+		long waitMillis = 0;
+		if (lua_isnumber(pL, 3)) waitMillis = std::max(0L, (long)lua_tointeger(pL, 3));
+
+		lua_pushboolean(pL, pTask->Write(std::string(chunk, len), waitMillis));
+		return 1;
+	}
+
+	lua_pushboolean(pL, false);
+	return 1;
+}
+
+int TaskLuaInterface::l_Task_CloseInput(lua_State* pL)
+{
+	std::shared_ptr<CoTask> pTask = std::dynamic_pointer_cast<CoTask>(l_PopTask(pL));
+
+	if (pTask != nullptr) pTask->CloseInput();
+
+	return 0;
+}
+
+int TaskLuaInterface::l_LuaWorker_AwaitAny(lua_State* pL)
+{
+	return l_AwaitMany(pL, false);
+}
+
+int TaskLuaInterface::l_LuaWorker_AwaitAll(lua_State* pL)
+{
+	return l_AwaitMany(pL, true);
+}
+
+int TaskLuaInterface::l_Task_AwaitAsync(lua_State* pL)
+{
+	if (lua_pushthread(pL))
+	{
+		luaL_error(pL, "AwaitAsync must be called from a coroutine!");
+		return 0;
+	}
+	lua_pop(pL, 1);
+
+	{
+		std::shared_ptr<Task> pTask = l_PopTask(pL);
+
+		if (pTask == nullptr) return 0;
+
+		if (pTask->IsResultReady())
+		{
+			// As dispatched by Pump: no result unless yielded or complete
+			TaskStatus status = pTask->GetStatus();
+			if (Task::IsFinal(status) && status != TaskStatus::Complete) return 0;
+
+			std::string result = pTask->GetResult();
+			lua_pushlstring(pL, result.data(), result.size());
+			return 1;
+		}
+
+		l_PushCallbackEntry(pL, pTask);
+		lua_getfield(pL, -1, "waiters");
+		if (!lua_istable(pL, -1))
+		{
+			lua_pop(pL, 1);
+			lua_newtable(pL);
+			lua_pushvalue(pL, -1);
+			lua_setfield(pL, -3, "waiters");
+		}
+			lua_pushthread(pL);
+		lua_rawseti(pL, -2, (int)lua_objlen(pL, -2) + 1);
+		lua_pop(pL, 2);
+
+		// Catch up on a result set before the waiter was added
+		if (pTask->IsResultReady()) l_GetDispatchQueue(pL)->OnTaskUpdated(pTask);
+	}
+
+	// No native objects left in scope if yielding raises an error
+	return lua_yield(pL, 0);
+}
+
+int TaskLuaInterface::l_Task_OnComplete(lua_State* pL)
+{
+	return l_SetCallback(pL, "complete");
+}
+
+int TaskLuaInterface::l_Task_OnYield(lua_State* pL)
+{
+	return l_SetCallback(pL, "yield");
+}
+
+int TaskLuaInterface::l_LuaWorker_Pump(lua_State* pL)
+{
+	long budgetMillis = 0;
+	if (lua_isnumber(pL, 1)) budgetMillis = std::max(0L, (long)lua_tointeger(pL, 1));
+
+	system_clock::time_point until = system_clock::now() + std::chrono::milliseconds(budgetMillis);
+	bool failed = false;
+	std::size_t pending = 0;
+
+	{
+		// Only tasks with callbacks or waiters in this lua state
+		std::shared_ptr<TaskCompletionQueue> pQueue = l_GetDispatchQueue(pL);
+
+		// Always dispatch at least one task, so a zero budget still makes progress
+		do
+		{
+			std::vector<std::shared_ptr<Task>> next = pQueue->Poll(1);
+			if (next.empty()) break;
+
+			failed = !l_DispatchCallback(pL, next.front());
+		} while (!failed && system_clock::now() < until);
+
+		pending = pQueue->Size();
+	}
+
+	if (failed)
+	{
+		lua_error(pL);
+		return 0;
+	}
+
+	lua_pushinteger(pL, (lua_Integer)pending);
+	return 1;
+}
\ No newline at end of file
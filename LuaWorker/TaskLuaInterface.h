@@ -31,6 +31,8 @@
 
 #include "AutoKeyMap.h"
 #include "Task.h"
+#include "CoTask.h"
+#include "TaskCompletionQueue.h"
 
 extern "C" {
 #include "lua.h"
@@ -50,12 +52,89 @@ namespace LuaWorker
 
 		static AutoKeyDeck::AutoKeyMap<int, Task> sTasks;
 
+		// Address used as registry key for the weak table of handles by task
+		static char sHandleCacheKey;
+
+		// Address used as registry key for the table of callbacks by task
+		static char sCallbacksKey;
+
+		// Address used as registry key for the queue of tasks with callbacks 
+		// in this lua state, awaiting dispatch by Pump
+		static char sDispatchQueueKey;
+
 		//-------------------------------
 		// Static Lua helper methods
 		//-------------------------------
 		static std::shared_ptr<Task> l_PopTask(lua_State* pL);
 		static std::shared_ptr<Task> l_PopTask(lua_State* pL, int& outKey);
 
+		/// <summary>
+		/// Get the task for a task handle at the given stack index
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="index">Stack index of the handle</param>
+		/// <returns>Task, or nullptr if the value is not a live task handle</returns>
+		static std::shared_ptr<Task> l_ToTask(lua_State* pL, int index);
+
+		/// <summary>
+		/// Push the weak-valued table mapping tasks to their handles in this lua state
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		static void l_PushHandleCache(lua_State* pL);
+
+		/// <summary>
+		/// Push the table of callbacks by task in this lua state
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		static void l_PushCallbacks(lua_State* pL);
+
+		/// <summary>
+		/// Push the callbacks entry for a task, creating it if needed
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="pTask">Task whose entry to push</param>
+		static void l_PushCallbackEntry(lua_State* pL, std::shared_ptr<Task> pTask);
+
+		/// <summary>
+		/// Get the dispatch queue of this lua state, creating it if needed.
+		/// The queue is owned by a registry userdata, so it is freed with the state.
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>The queue</returns>
+		static std::shared_ptr<TaskCompletionQueue> l_GetDispatchQueue(lua_State* pL);
+
+		/// <summary>
+		/// Destroy a dispatch queue userdata. Called by lua gc.
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_DispatchQueue_Delete(lua_State* pL);
+
+		/// <summary>
+		/// Shared implementation of OnComplete/OnYield
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="field">Name of callback in the task's callbacks table</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_SetCallback(lua_State* pL, const char* field);
+
+		/// <summary>
+		/// Resume coroutines awaiting a task and run the callback due, 
+		/// for a task updated since the last dispatch
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="pTask">Task to dispatch for</param>
+		/// <returns>False if a callback or coroutine raised an error (first error message left at the top of the stack)</returns>
+		static bool l_DispatchCallback(lua_State* pL, std::shared_ptr<Task> pTask);
+
+		/// <summary>
+		/// Shared implementation of AwaitAny/AwaitAll
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="all">True to wait for all tasks</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_AwaitMany(lua_State* pL, bool all);
+
 	public:
 
 		//-------------------------------
@@ -78,6 +157,15 @@ namespace LuaWorker
 		/// <returns>Number of items pushed to the stack</returns>
 		static int l_PushTask(lua_State* pL, std::shared_ptr<Task> pTask);
 
+		/// <summary>
+		/// Push the existing handle for a task if it is still referenced 
+		/// in this lua state, otherwise push a new handle
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="pTask">Task whose handle to push</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_PushTaskHandle(lua_State* pL, std::shared_ptr<Task> pTask);
+
 		//-------------------------------
 		// Static Lua-callable methods
 		//-------------------------------
@@ -101,6 +189,17 @@ namespace LuaWorker
 		/// <returns>Number of items pushed to the stack</returns>
 		static int l_Task_Await(lua_State* pL);
 
+		/// <summary>
+		/// Cancel the task. Removes it from its worker's queue if not
+		/// started, otherwise interrupts it with an error if running.
+		/// 
+		/// Lua syntax:
+		///		task:Cancel()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Task_Cancel(lua_State* pL);
+
 		/// <summary>
 		/// Pop Task handle from the top of the lua stack
 		/// return the TaskStatus_... constant representing
@@ -123,6 +222,109 @@ namespace LuaWorker
 		/// <param name="pL">Lua state</param>
 		/// <returns>Number of items pushed to the stack</returns>
 		static int l_Task_Finalized(lua_State* pL);
+
+		/// <summary>
+		/// Pop Task handle from the top of the lua stack
+		/// return a table of all results emitted by the task 
+		/// since the last call (oldest first)
+		/// 
+		/// Lua syntax:
+		///		local items = task:Drain()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Task_Drain(lua_State* pL);
+
+		/// <summary>
+		/// Push an input chunk to a coroutine task, blocking for up to
+		/// the specified time while its input buffer is full.
+		/// Returns true if the chunk was queued.
+		/// 
+		/// Lua syntax:
+		///		local ok = task:Write(chunk, waitMillis)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Task_Write(lua_State* pL);
+
+		/// <summary>
+		/// Signal end of input to a coroutine task
+		/// 
+		/// Lua syntax:
+		///		task:CloseInput()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Task_CloseInput(lua_State* pL);
+
+		/// <summary>
+		/// Yield the calling coroutine until the task has a result or is final.
+		/// The coroutine is resumed from LuaWorker.Pump with the result.
+		/// 
+		/// Lua syntax:
+		///		local resultString = task:AwaitAsync()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Task_AwaitAsync(lua_State* pL);
+
+		/// <summary>
+		/// Set function to call from LuaWorker.Pump once the task is final.
+		/// Returns the task handle.
+		/// 
+		/// Lua syntax:
+		///		task:OnComplete(function(result, task) end)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Task_OnComplete(lua_State* pL);
+
+		/// <summary>
+		/// Set function to call from LuaWorker.Pump when the task yields a result.
+		/// Returns the task handle.
+		/// 
+		/// Lua syntax:
+		///		task:OnYield(function(result, task) end)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Task_OnYield(lua_State* pL);
+
+		/// <summary>
+		/// Block until any of the task handles in a table has a result
+		/// or is final, or until timeout.
+		/// Returns a table of the ready handles.
+		/// 
+		/// Lua syntax:
+		///		local ready = LuaWorker.AwaitAny({task1, task2}, waitMillis)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_LuaWorker_AwaitAny(lua_State* pL);
+
+		/// <summary>
+		/// Block until all of the task handles in a table have a result
+		/// or are final, or until timeout.
+		/// Returns a table of the ready handles.
+		/// 
+		/// Lua syntax:
+		///		local ready = LuaWorker.AwaitAll({task1, task2}, waitMillis)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_LuaWorker_AwaitAll(lua_State* pL);
+
+		/// <summary>
+		/// Run pending task callbacks set in this lua state and resume coroutines waiting in 
+		/// AwaitAsync until the time budget is used.
+		/// Returns the number of tasks still awaiting dispatch.
+		/// 
+		/// Lua syntax:
+		///		local pending = LuaWorker.Pump(budgetMillis)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_LuaWorker_Pump(lua_State* pL);
 	};
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,43 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _TASK_OBSERVER_H_
+#define _TASK_OBSERVER_H_
+#pragma once
+
+#include <memory> 
+
+namespace LuaWorker
+{
+	class Task;
+
+	/// <summary>
+	/// Interface for objects notified when a task sets a result or changes to a final status
+	/// </summary>
+	class TaskObserver
+	{
+	public:
+		/// <summary>
+		/// Called on the thread updating the task, with no task locks held
+		/// </summary>
+		/// <param name="task">Task updated</param>
+		virtual void OnTaskUpdated(const std::shared_ptr<Task>& task) = 0;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,83 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#include "TaskWaiter.h"
+
+using namespace LuaWorker;
+using std::chrono::system_clock;
+
+//------
+TaskWaiter::TaskWaiter() : mGeneration(0) {}
+
+//------
+unsigned long TaskWaiter::GetGeneration()
+{
+	std::unique_lock<std::mutex> lock(mMtx);
+
+	return mGeneration;
+}
+
+//------
+bool TaskWaiter::WaitForUpdate(unsigned long generation, const system_clock::time_point& until)
+{
+	std::unique_lock<std::mutex> lock(mMtx);
+
+	return mCv.wait_until(lock, until, [this, generation] {return mGeneration != generation; });
+}
+
+//------
+void TaskWaiter::OnTaskUpdated(const std::shared_ptr<Task>&)
+{
+	{
+		std::unique_lock<std::mutex> lock(mMtx);
+
+		++mGeneration;
+	}
+	mCv.notify_all();
+}
+
+//------
+std::vector<std::size_t> TaskWaiter::WaitFor(const std::vector<std::shared_ptr<Task>>& tasks, bool all, unsigned int waitForMillis)
+{
+	std::shared_ptr<TaskWaiter> waiter = std::make_shared<TaskWaiter>();
+	system_clock::time_point until = system_clock::now() + std::chrono::milliseconds(waitForMillis);
+
+	for (const std::shared_ptr<Task>& task : tasks) task->AddObserver(waiter);
+
+	std::vector<std::size_t> ready;
+
+	while (true)
+	{
+		unsigned long generation = waiter->GetGeneration();
+
+		ready.clear();
+		for (std::size_t i = 0; i < tasks.size(); ++i)
+		{
+			if (tasks[i]->IsResultReady()) ready.push_back(i);
+		}
+
+		if (all ? ready.size() == tasks.size() : !ready.empty()) break;
+		if (system_clock::now() >= until) break;
+
+		waiter->WaitForUpdate(generation, until);
+	}
+
+	for (const std::shared_ptr<Task>& task : tasks) task->RemoveObserver(waiter.get());
+
+	return ready;
+}
\ No newline at end of file
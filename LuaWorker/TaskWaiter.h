@@ -0,0 +1,85 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _TASK_WAITER_H_
+#define _TASK_WAITER_H_
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <memory>
+
+#include "Task.h"
+#include "TaskObserver.h"
+
+namespace LuaWorker
+{
+	/// <summary>
+	/// Single wait object signalled by updates to any of a set of tasks
+	/// </summary>
+	class TaskWaiter : public TaskObserver
+	{
+	private:
+
+		std::mutex mMtx;
+		std::condition_variable mCv;
+
+		// Incremented on each notification, so updates between checks are not lost
+		unsigned long mGeneration;
+
+	public:
+
+		TaskWaiter();
+
+		/// <summary>
+		/// Get the number of notifications received so far
+		/// </summary>
+		/// <returns>Current generation</returns>
+		unsigned long GetGeneration();
+
+		/// <summary>
+		/// Block until a notification is received after the given generation, or until timeout
+		/// </summary>
+		/// <param name="generation">Generation last seen by the caller</param>
+		/// <param name="until">Time to stop waiting</param>
+		/// <returns>True if a notification was received</returns>
+		bool WaitForUpdate(unsigned long generation, const std::chrono::system_clock::time_point& until);
+
+		//-------------------------------
+		// TaskObserver
+		//-------------------------------
+
+		void OnTaskUpdated(const std::shared_ptr<Task>& task) override;
+
+		//-------------------------------
+		// Static methods
+		//-------------------------------
+
+		/// <summary>
+		/// Block until any (or all) of the given tasks have a result ready or are final
+		/// </summary>
+		/// <param name="tasks">Tasks to wait for</param>
+		/// <param name="all">If true, wait for all tasks, otherwise wait for any</param>
+		/// <param name="waitForMillis">Max wait time</param>
+		/// <returns>Indices of the ready tasks, in the order given</returns>
+		static std::vector<std::size_t> WaitFor(const std::vector<std::shared_ptr<Task>>& tasks, bool all, unsigned int waitForMillis);
+	};
+};
+#endif
\ No newline at end of file
@@ -121,6 +121,24 @@ namespace LuaWorker
 		}
 
 
+		/// <summary>
+		/// Get the task managed by this pack
+		/// </summary>
+		/// <returns>The task</returns>
+		std::shared_ptr<T_Task> GetTask()
+		{
+			return mTask;
+		}
+
+		/// <summary>
+		/// Get the task managed by this pack
+		/// </summary>
+		/// <returns>The task</returns>
+		Task* GetBaseTask()
+		{
+			return mTask.get();
+		}
+
 		/// <summary>
 		/// Permanently cancel execution and any pending tasks
 		/// </summary>
@@ -0,0 +1,32 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _WAKEABLE_H_
+#define _WAKEABLE_H_
+#pragma once
+
+/// <summary>
+/// Interface for objects that can be woken to re-check pending work
+/// </summary>
+class Wakeable 
+{
+public:
+	virtual void Wake() = 0;
+};
+
+#endif
\ No newline at end of file
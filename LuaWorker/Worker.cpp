@@ -17,16 +17,19 @@
 \*****************************************************************************/
 
 #include<functional>
+#include<algorithm>
 
 #include "TaskExecPack.h"
 #include "LogSection.h"
 #include "InnerLuaState.h"
+#include "LuaStatePool.h"
 #include "Worker.h"
 #include "TaskExecPack.h"
 #include "OneShotTaskExecPack.h"
 #include "CoTaskExecPack.h"
 #include "OneShotTask.h"
 #include "CoTask.h"
+#include "TaskDoInit.h"
 
 using namespace LuaWorker;
 
@@ -36,19 +39,60 @@ using namespace LuaWorker;
 
 void Worker::ThreadMain()
 {
-	mLog.Push(LogLevel::Info, "Thread starting.");
+	InnerLuaState lua(mLog, mOptions);
+
+	ThreadMainRun(lua);
+}
 
-	InnerLuaState lua(mLog);
+//------
+void Worker::ThreadMainRun(InnerLuaState& lua)
+{
+	mLog.Push(LogLevel::Info, "Thread starting.");
 
-	if (ThreadMainInitLua(lua)) mLog.Push(LogLevel::Info, "Lua opened on worker.");
+	if (ThreadMainInitLua(lua))
+	{
+		mLog.Push(LogLevel::Info, "Lua opened on worker.");
 
-	ThreadMainLoop(lua);
+		ThreadMainLoop(lua);
+	}
 
 	mLog.Push(LogLevel::Info, "Thread stopping.");
 
 	Cancel(); // Ensure tasks cancelled and status updated
 
-	ThreadMainCloseLua(lua);
+	ThreadMainCloseLua(mRecycledLua != nullptr ? *mRecycledLua : lua);
+
+	// Helper threads use lua, or this
+	if (mNextLua.valid()) mNextLua.get();
+	if (mRetiredLua.valid()) mRetiredLua.get();
+	mRecycledLua.reset();
+}
+
+//------
+bool Worker::StartPooled()
+{
+	// Preload and init run after adoption, so do not affect the state
+	WorkerOptions stateOptions(mOptions);
+	stateOptions.preload.clear();
+	stateOptions.init.clear();
+
+	if (!(stateOptions == WorkerOptions())) return false;
+
+	std::shared_ptr<Worker> self = weak_from_this().lock();
+	if (self == nullptr) return false;
+
+	{
+		std::unique_lock<std::mutex> lock(mPooledRunMtx);
+		mPooledRun = true;
+	}
+
+	if (LuaStatePool::Instance().Adopt(self)) return true;
+
+	{
+		std::unique_lock<std::mutex> lock(mPooledRunMtx);
+		mPooledRun = false;
+	}
+	return false;
 }
 
 //------
@@ -56,8 +100,6 @@ bool Worker::ThreadMainInitLua(InnerLuaState& lua)
 {
 	try
 	{
-		mCurrentStatus = WorkerStatus::Processing;
-
 		{
 			std::unique_lock<std::mutex> lock(mLuaCancelMtx);
 			mLuaCancel = &lua;
@@ -65,16 +107,165 @@ bool Worker::ThreadMainInitLua(InnerLuaState& lua)
 		
 		lua.Open();
 
+		if (mCancel) return false;
+
+		if (!lua.IsOpen())
+		{
+			mReadyTask->SetError("Lua not initialized.");
+			mCurrentStatus = WorkerStatus::Error;
+			return false;
+		}
+
+		if (!ThreadMainRunInit(lua, mReadyTask)) return false;
+
+		// Unless stopped meanwhile
+		WorkerStatus starting = WorkerStatus::Starting;
+		mCurrentStatus.compare_exchange_strong(starting, WorkerStatus::Processing);
+
 		return true;
 	}
 	catch (const std::exception& ex)
 	{
 		mLog.Push(ex);
+		mReadyTask->SetError("Exception occurred during initialization");
 		mCurrentStatus = WorkerStatus::Error;
 	}
 	return false;
 }
 
+//------
+bool Worker::ThreadMainRunInit(InnerLuaState& lua, const std::shared_ptr<TaskDoInit>& task)
+{
+	lua.ExecTask(std::make_unique<OneShotTaskExecPack>(task, LogSection(mLog)));
+
+	mLastTaskAt = std::chrono::steady_clock::now();
+	mOpenedAt = mLastTaskAt;
+	mTasksSinceOpen = 0;
+
+	if (mCancel) return false; // Stopped during init
+
+	if (task->GetStatus() == TaskStatus::Error)
+	{
+		mCurrentStatus = WorkerStatus::Error;
+		return false;
+	}
+
+	return true;
+}
+
+//------
+bool Worker::ThreadMainReopenLua(InnerLuaState& lua)
+{
+	lua.Open();
+
+	if (!lua.IsOpen()) return false;
+
+	mHibernated = false;
+	mLog.Push(LogLevel::Info, "Lua reopened on worker.");
+
+	return ThreadMainRunInit(lua, std::make_shared<TaskDoInit>(mOptions.preload, mOptions.init));
+}
+
+//------
+bool Worker::IsRecycleDue(InnerLuaState& lua)
+{
+	if (mNextLua.valid() || !lua.IsOpen()) return false;
+
+	if (mOptions.recycleAfterTasks > 0 && mTasksSinceOpen >= mOptions.recycleAfterTasks) return true;
+
+	if (mOptions.recycleAfterMillis > 0
+		&& std::chrono::steady_clock::now() - mOpenedAt >= std::chrono::milliseconds(mOptions.recycleAfterMillis)) return true;
+
+	if (mOptions.recycleAboveBytes > 0)
+	{
+		AllocatorStats stats = lua.GetMemoryStats();
+		if (std::max(stats.bytesInUse, stats.arenaBytes) > mOptions.recycleAboveBytes) return true;
+	}
+
+	return false;
+}
+
+//------
+std::unique_ptr<InnerLuaState> Worker::PrepareLua()
+{
+	std::unique_ptr<InnerLuaState> next;
+	bool ready = false;
+
+	try
+	{
+		next = std::make_unique<InnerLuaState>(mLog, mOptions);
+
+		{
+			std::unique_lock<std::mutex> lock(mLuaCancelMtx);
+			if (mCancel) return nullptr;
+			mLuaPreparing = next.get();
+		}
+
+		next->Open();
+
+		if (next->IsOpen())
+		{
+			std::shared_ptr<TaskDoInit> init = std::make_shared<TaskDoInit>(mOptions.preload, mOptions.init);
+			next->ExecTask(std::make_unique<OneShotTaskExecPack>(init, LogSection(mLog)));
+
+			ready = init->GetStatus() == TaskStatus::Complete;
+		}
+	}
+	catch (const std::exception& ex)
+	{
+		if (!mCancel) mLog.Push(ex);
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mLuaCancelMtx);
+		mLuaPreparing = nullptr;
+	}
+
+	if (!ready)
+	{
+		if (!mCancel) mLog.Push(LogLevel::Error, "Failed to prepare replacement lua state.");
+		return nullptr;
+	}
+	return next;
+}
+
+//------
+InnerLuaState& Worker::SwapRecycledLua(InnerLuaState& lua)
+{
+	if (!mNextLua.valid() || mNextLua.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return lua;
+
+	if (lua.HasSuspendedTasks()) return lua; // Coroutines would be lost
+
+	std::unique_ptr<InnerLuaState> next = mNextLua.get();
+	if (next == nullptr) return lua;
+
+	{
+		std::unique_lock<std::mutex> lock(mLuaCancelMtx);
+		mLuaCancel = next.get();
+	}
+
+	// Close the old state off the worker thread. It is owned by the caller of ThreadMainRun until the first recycle.
+	if (mRetiredLua.valid()) mRetiredLua.get();
+
+	InnerLuaState* pRetired = &lua;
+	std::shared_ptr<InnerLuaState> retiredOwner(std::move(mRecycledLua));
+	mRetiredLua = std::async(std::launch::async, [pRetired, retiredOwner]() mutable 
+	{ 
+		pRetired->Close(); 
+		retiredOwner.reset();
+	});
+
+	mRecycledLua = std::move(next);
+
+	mOpenedAt = std::chrono::steady_clock::now();
+	mTasksSinceOpen = 0;
+	mHibernated = false;
+
+	mLog.Push(LogLevel::Info, "Lua state recycled.");
+
+	return *mRecycledLua;
+}
+
 //------
 bool Worker::ThreadMainCloseLua(InnerLuaState& lua)
 {
@@ -101,20 +292,58 @@ std::unique_ptr<TaskExecPack> Worker::RunCurrentTasks(InnerLuaState& lua)
 {
 	while (!mCancel)
 	{
+		lua.WakeInputWaiters();
+
 		std::optional<std::chrono::system_clock::time_point> nextResume = lua.GetNextResume();
+		bool idleGC = false;
+		bool hibernate = false;
+
+		std::optional<std::chrono::steady_clock::time_point> hibernateAt;
+		if (mOptions.idleTimeoutMillis > 0 && !mHibernated && lua.IsOpen() && !lua.HasSuspendedTasks())
+		{
+			hibernateAt = mLastTaskAt + std::chrono::milliseconds(mOptions.idleTimeoutMillis);
+		}
 
 		{
 			std::unique_lock<std::mutex> lock(mTasksMtx);
 			while (!mCancel)
 			{
+				if (mPaused)
+				{
+					mTaskCancelCv.wait(lock);
+					continue;
+				}
+
 				if (!mTaskQueue.empty())
 				{
 					std::unique_ptr<TaskExecPack> newTaskOut(std::move(mTaskQueue.front()));
+					mQueuedTasks.erase(newTaskOut->GetBaseTask());
 					mTaskQueue.pop_front();
 					return newTaskOut;
 				}
 
-				if (!nextResume.has_value())
+				if (mWakePending)
+				{
+					mWakePending = false;
+					break; // Input arrived for waiting tasks
+				}
+
+				if (lua.HasIdleGCWork() && (!nextResume.has_value() || nextResume.value() > std::chrono::system_clock::now()))
+				{
+					idleGC = true;
+					break; // Collect garbage instead of waiting
+				}
+
+				if (!nextResume.has_value() && hibernateAt.has_value())
+				{
+					if (hibernateAt.value() <= std::chrono::steady_clock::now())
+					{
+						hibernate = true;
+						break; // Idle timeout
+					}
+					mTaskCancelCv.wait_until(lock, hibernateAt.value());
+				}
+				else if (!nextResume.has_value())
 				{
 					mTaskCancelCv.wait(lock);
 				}
@@ -128,13 +357,34 @@ std::unique_ptr<TaskExecPack> Worker::RunCurrentTasks(InnerLuaState& lua)
 
 		if (mCancel) break;
 
+		if (idleGC)
+		{
+			// One bounded step, then check for new or due tasks again
+			lua.StepIdleGC();
+			continue;
+		}
+
+		if (hibernate)
+		{
+			mHibernated = true;
+			if (lua.Hibernate(mOptions.idleClose)) 
+			{
+				mLog.Push(LogLevel::Info, mOptions.idleClose ? "Lua closed while idle." : "Garbage collected while idle.");
+			}
+			continue;
+		}
+
 		if (!lua.IsOpen())
 		{
+			if (mHibernated) continue; // Nothing suspended to resume
+
 			mLog.Push(LogLevel::Error, "Lua not initialized.");
 			break;
 		}
 
 		lua.ResumeTask();
+
+		mLastTaskAt = std::chrono::steady_clock::now();
 	}
 
 	return nullptr;
@@ -143,24 +393,34 @@ std::unique_ptr<TaskExecPack> Worker::RunCurrentTasks(InnerLuaState& lua)
 //------
 void Worker::ThreadMainLoop(InnerLuaState& lua)
 {
+	InnerLuaState* pLua = &lua;
+
 	try
 	{
 		while (!mCancel)
 		{
-			std::unique_ptr<TaskExecPack> currentTask (RunCurrentTasks(lua));
+			std::unique_ptr<TaskExecPack> currentTask (RunCurrentTasks(*pLua));
 			
 			if (currentTask == nullptr) break;
 
 			if (mCancel) break;
 			else if (currentTask->GetStatus() != TaskStatus::NotStarted) continue;
 
-			if (!lua.IsOpen())
+			pLua = &SwapRecycledLua(*pLua);
+
+			if (!pLua->IsOpen() && !(mHibernated && ThreadMainReopenLua(*pLua)))
 			{
 				mLog.Push(LogLevel::Error, "Lua not initialized.");
 				break;
 			}
 
-			TaskExecPack::VisitLuaState(std::move(currentTask), &lua);
+			TaskExecPack::VisitLuaState(std::move(currentTask), pLua);
+
+			mLastTaskAt = std::chrono::steady_clock::now();
+			mHibernated = false;
+
+			++mTasksSinceOpen;
+			if (IsRecycleDue(*pLua)) mNextLua = std::async(std::launch::async, &Worker::PrepareLua, this);
 		}
 	}
 	catch (const std::exception& ex)
@@ -176,6 +436,8 @@ void Worker::Cancel()
 	mCancel = true;
 	if (mCurrentStatus != WorkerStatus::Error) mCurrentStatus = WorkerStatus::Cancelled;
 
+	mReadyTask->Cancel(); // If never started
+
 	//CancelAllTasks();
 
 	mTaskCancelCv.notify_all();
@@ -183,9 +445,26 @@ void Worker::Cancel()
 	{
 		std::unique_lock<std::mutex> lock(mLuaCancelMtx);
 		if (mLuaCancel != nullptr) mLuaCancel->Cancel();
+		if (mLuaPreparing != nullptr) mLuaPreparing->Cancel();
 	}
 }
 
+//------
+bool Worker::QueueTask(const Task* task, std::unique_ptr<TaskExecPack>&& pack)
+{
+	{
+		std::unique_lock<std::mutex> lock(mTasksMtx);
+
+		if (mCancel) return false;
+
+		mTaskQueue.push_back(std::move(pack));
+		mQueuedTasks[task] = std::prev(mTaskQueue.end());
+	}
+	mTaskCancelCv.notify_all();
+
+	return true;
+}
+
 //------
 //void Worker::CancelAllTasks()
 //{
@@ -204,10 +483,22 @@ void Worker::Cancel()
 // Public methods
 //-------------------------------
 
-Worker::Worker(LogSection && log) : mCancel(false), 
+Worker::Worker(LogSection && log, const WorkerOptions& options) : mWakePending(false),
+									mPaused(false),
+									mCompletionQueue(std::make_shared<TaskCompletionQueue>()),
+									mCompletionQueueUsed(false),
+									mCancel(false), 
 									mCurrentStatus(WorkerStatus::NotStarted), 
 									mLog(log), 
-									mLuaCancel(nullptr){}
+									mOptions(options),
+									mReadyTask(std::make_shared<TaskDoInit>(options.preload, options.init)),
+									mLastTaskAt(),
+									mHibernated(false),
+									mLuaCancel(nullptr),
+									mLuaPreparing(nullptr),
+									mTasksSinceOpen(0),
+									mOpenedAt(),
+									mPooledRun(false){}
 
 //------
 Worker::~Worker()
@@ -230,15 +521,25 @@ Worker::~Worker()
 //------
 WorkerStatus Worker::Start()
 {
-	if (!mThread.joinable() && !mCancel) 
+	bool pooledRun;
+	{
+		std::unique_lock<std::mutex> lock(mPooledRunMtx);
+		pooledRun = mPooledRun;
+	}
+
+	if (!mThread.joinable() && !pooledRun && !mCancel) 
 	{
 		mLog.Push(LogLevel::Info, "Thread start requested.");
 
 		std::unique_lock<std::mutex> lock(mTasksMtx);
 
-		if(!mCancel) mThread = std::thread( &Worker::ThreadMain, this);
-
+		// Set before the thread can set Processing
 		mCurrentStatus = WorkerStatus::Starting;
+
+		if (mCompletionQueueUsed) mReadyTask->AddObserver(mCompletionQueue);
+		mReadyTask->AddObserver(weak_from_this());
+
+		if (!mCancel && !StartPooled()) mThread = std::thread( &Worker::ThreadMain, this);
 	}
 	return mCurrentStatus;
 }
@@ -253,24 +554,42 @@ WorkerStatus Worker::Stop()
 	{
 		mThread.join();
 	}
+	else
+	{
+		std::unique_lock<std::mutex> lock(mPooledRunMtx);
+		mPooledRunCv.wait(lock, [this]() { return !mPooledRun; });
+	}
 	return mCurrentStatus;
 }
 
 //------
-WorkerStatus Worker::AddTask(std::shared_ptr<OneShotTask> task)
-{	
-	std::unique_ptr<OneShotTaskExecPack> pack = std::make_unique<OneShotTaskExecPack>(task, LogSection(mLog));
-
+WorkerStatus Worker::Pause()
+{
 	{
 		std::unique_lock<std::mutex> lock(mTasksMtx);
 
-		if (mCancel)
+		WorkerStatus processing = WorkerStatus::Processing;
+		if (!mCancel && mCurrentStatus.compare_exchange_strong(processing, WorkerStatus::Paused))
 		{
-			task->Cancel();
-			return mCurrentStatus;
+			mPaused = true;
+			mLog.Push(LogLevel::Info, "Worker paused.");
 		}
+	}
+	return mCurrentStatus;
+}
 
-		mTaskQueue.push_back(std::move(pack));
+//------
+WorkerStatus Worker::Resume()
+{
+	{
+		std::unique_lock<std::mutex> lock(mTasksMtx);
+
+		WorkerStatus paused = WorkerStatus::Paused;
+		if (mPaused && mCurrentStatus.compare_exchange_strong(paused, WorkerStatus::Processing))
+		{
+			mPaused = false;
+			mLog.Push(LogLevel::Info, "Worker resumed.");
+		}
 	}
 	mTaskCancelCv.notify_all();
 
@@ -278,24 +597,58 @@ WorkerStatus Worker::AddTask(std::shared_ptr<OneShotTask> task)
 }
 
 //------
-WorkerStatus Worker::AddTask(std::shared_ptr<CoTask> task)
+void Worker::ThreadMainPooled(InnerLuaState& lua)
 {
-	std::unique_ptr<CoTaskExecPack> pack = std::make_unique<CoTaskExecPack>(task, LogSection(mLog));
+	mLog.Push(LogLevel::Info, "Adopted lua state from pool.");
+
+	lua.SetLog(mLog);
+
+	ThreadMainRun(lua);
 
 	{
-		std::unique_lock<std::mutex> lock(mTasksMtx);
+		std::unique_lock<std::mutex> lock(mPooledRunMtx);
+		mPooledRun = false;
+	}
+	mPooledRunCv.notify_all();
+}
 
-		if (mCancel)
-		{
-			task->Cancel();
-			return mCurrentStatus;
-		}
+//------
+WorkerStatus Worker::AddTask(std::shared_ptr<OneShotTask> task)
+{	
+	if (mCompletionQueueUsed) task->AddObserver(mCompletionQueue);
+	task->AddObserver(weak_from_this());
 
-		mTaskQueue.push_back(std::move(pack));
+	if (!QueueTask(task.get(), std::make_unique<OneShotTaskExecPack>(task, LogSection(mLog)))) task->Cancel();
+
+	return mCurrentStatus;
+}
+
+//------
+WorkerStatus Worker::AddTask(std::shared_ptr<CoTask> task)
+{
+	task->SetInputListener(weak_from_this());
+	if (mCompletionQueueUsed) task->AddObserver(mCompletionQueue);
+	task->AddObserver(weak_from_this());
+
+	if (!QueueTask(task.get(), std::make_unique<CoTaskExecPack>(task, LogSection(mLog)))) task->Cancel();
+
+	return mCurrentStatus;
+}
+
+//------
+void Worker::Wake()
+{
+	{
+		std::unique_lock<std::mutex> lock(mTasksMtx);
+		mWakePending = true;
 	}
 	mTaskCancelCv.notify_all();
+}
 
-	return mCurrentStatus;
+//------
+std::shared_ptr<Task> Worker::GetReadyTask()
+{
+	return mReadyTask;
 }
 
 //------
@@ -304,6 +657,62 @@ WorkerStatus Worker::GetStatus()
 	return mCurrentStatus;
 }
 
+//------
+std::vector<std::shared_ptr<Task>> Worker::PollCompleted(std::size_t maxCount)
+{
+	mCompletionQueueUsed = true;
+
+	return mCompletionQueue->Poll(maxCount);
+}
+
+//------
+std::shared_ptr<TaskCompletionQueue> Worker::GetCompletionQueue()
+{
+	mCompletionQueueUsed = true;
+
+	return mCompletionQueue;
+}
+
+//------
+AllocatorStats Worker::GetMemoryStats()
+{
+	std::unique_lock<std::mutex> lock(mLuaCancelMtx);
+
+	if (mLuaCancel == nullptr) return AllocatorStats();
+
+	return mLuaCancel->GetMemoryStats();
+}
+
+//------
+void Worker::OnTaskUpdated(const std::shared_ptr<Task>& task)
+{
+	if (!task->IsCancelled()) return;
+
+	std::unique_ptr<TaskExecPack> unlinked; // Destroy outside the lock
+
+	{
+		std::unique_lock<std::mutex> lock(mTasksMtx);
+
+		auto it = mQueuedTasks.find(task.get());
+		if (it != mQueuedTasks.end())
+		{
+			unlinked = std::move(*it->second);
+			mTaskQueue.erase(it->second);
+			mQueuedTasks.erase(it);
+		}
+	}
+
+	if (unlinked != nullptr) return;
+
+	// Already started: interrupt if running, or release if waiting for input
+	{
+		std::unique_lock<std::mutex> lock(mLuaCancelMtx);
+		if (mLuaCancel != nullptr) mLuaCancel->CancelTask(task.get());
+	}
+
+	Wake();
+}
+
 //------
 std::shared_ptr<LogOutput> Worker::GetLogOutput()
 {
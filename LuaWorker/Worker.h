@@ -23,15 +23,24 @@
 //#include <iostream>
 //#include <filesystem>
 #include <thread>
+#include <future>
 //#include <deque> 
 #include <mutex> 
+#include <memory>
+#include <list>
+#include <unordered_map> 
 
 #include "TaskExecPack.h"
 #include "LogSection.h"
 #include "InnerLuaState.h"
 #include "Cancelable.h"
+#include "Wakeable.h"
 #include "CoTask.h"
 #include "OneShotTask.h"
+#include "TaskCompletionQueue.h"
+#include "WorkerOptions.h"
+#include "TaskObserver.h"
+#include "TaskDoInit.h"
 
 extern "C" {
 //#include "lua.h"
@@ -47,6 +56,7 @@ namespace LuaWorker
 		NotStarted,
 		Starting,
 		Processing,
+		Paused,
 		Cancelled,	// Final
 		Error		// Final
 	};
@@ -54,26 +64,62 @@ namespace LuaWorker
 	/// <summary>
 	/// Class to manage a worker thread executing Tasks in a lua instance
 	/// </summary>
-	class Worker : public Cancelable
+	class Worker : public Cancelable, public Wakeable, public TaskObserver, public std::enable_shared_from_this<Worker>
 	{
 	private:
 
 		std::thread mThread;
 
-		std::deque<std::unique_ptr<TaskExecPack>> mTaskQueue;
+		typedef std::list<std::unique_ptr<TaskExecPack>> T_TaskQueue;
+
+		T_TaskQueue mTaskQueue;
+		std::unordered_map<const Task*, T_TaskQueue::iterator> mQueuedTasks; // For unlinking cancelled tasks
 		std::mutex mTasksMtx;
 
 		std::condition_variable mTaskCancelCv;
 
+		bool mWakePending;
+
+		// No tasks are run or resumed while set. Guarded by mTasksMtx.
+		bool mPaused;
+
+		std::shared_ptr<TaskCompletionQueue> mCompletionQueue;
+
+		// Set by the first PollCompleted or GetCompletionQueue. Tasks are only queued 
+		// for completion after that, so hosts which never poll accumulate nothing.
+		std::atomic<bool> mCompletionQueueUsed;
+
 		std::atomic<bool> mCancel;
 
 		std::atomic<WorkerStatus> mCurrentStatus;
 
 		LogSection mLog;
 
-		Cancelable* mLuaCancel;
+		const WorkerOptions mOptions;
+
+		// Runs options.preload and options.init once the lua state is open
+		std::shared_ptr<TaskDoInit> mReadyTask;
+
+		//Access in worker thread only
+		std::chrono::steady_clock::time_point mLastTaskAt;
+		bool mHibernated;
+
+		InnerLuaState* mLuaCancel;
+		InnerLuaState* mLuaPreparing; // Replacement state opening on a helper thread
 		std::mutex mLuaCancelMtx;
 
+		//Access in worker thread only
+		std::unique_ptr<InnerLuaState> mRecycledLua; // State in use after the first recycle
+		std::future<std::unique_ptr<InnerLuaState>> mNextLua;
+		std::future<void> mRetiredLua;
+		unsigned long mTasksSinceOpen;
+		std::chrono::steady_clock::time_point mOpenedAt;
+
+		// Set while running on a thread from the LuaStatePool
+		bool mPooledRun;
+		std::mutex mPooledRunMtx;
+		std::condition_variable mPooledRunCv;
+
 		//---------------------
 		// Private Methods
 		//---------------------
@@ -82,13 +128,57 @@ namespace LuaWorker
 		/// Method executed by the worker thread
 		/// </summary>
 		void ThreadMain();
+
+		/// <summary>
+		/// Run the worker on the current thread with the passed state, until cancelled
+		/// </summary>
+		/// <param name="lua">State to use, open or not</param>
+		void ThreadMainRun(InnerLuaState& lua);
+
+		/// <summary>
+		/// Hand this worker to a parked LuaStatePool thread, if its options match the pool
+		/// </summary>
+		/// <returns>True if adopted</returns>
+		bool StartPooled();
 	
 		/// <summary>
-		/// Setup lua environment for main thread
+		/// Setup lua environment for main thread, and run the ready task
 		/// </summary>
 		/// <returns>True on success</returns>
 		bool ThreadMainInitLua(InnerLuaState& lua);
 
+		/// <summary>
+		/// Run a task loading the preload modules and init string of this worker
+		/// </summary>
+		/// <returns>False if the task failed, or the worker was cancelled</returns>
+		bool ThreadMainRunInit(InnerLuaState& lua, const std::shared_ptr<TaskDoInit>& task);
+
+		/// <summary>
+		/// Open the lua state again after it was closed while idle, and rerun the init
+		/// </summary>
+		/// <returns>True on success</returns>
+		bool ThreadMainReopenLua(InnerLuaState& lua);
+
+		/// <summary>
+		/// Check whether the recycle options call for a replacement of a state
+		/// </summary>
+		/// <returns>True if a replacement should be prepared</returns>
+		bool IsRecycleDue(InnerLuaState& lua);
+
+		/// <summary>
+		/// Open a replacement lua state and run the init in it. Called on a helper thread.
+		/// </summary>
+		/// <returns>The state, or nullptr on failure</returns>
+		std::unique_ptr<InnerLuaState> PrepareLua();
+
+		/// <summary>
+		/// Swap in a prepared replacement state, if ready and no tasks are suspended in the current one.
+		/// The current state is closed on a helper thread.
+		/// </summary>
+		/// <param name="lua">State in use</param>
+		/// <returns>State to use from now on</returns>
+		InnerLuaState& SwapRecycledLua(InnerLuaState& lua);
+
 		/// <summary>
 		/// Close Lua for main thread
 		/// </summary>
@@ -110,6 +200,14 @@ namespace LuaWorker
 		/// </summary>
 		void Cancel();
 
+		/// <summary>
+		/// Add a task pack to the queue, unless cancelled.
+		/// </summary>
+		/// <param name="task">Task in the pack</param>
+		/// <param name="pack">Pack to queue</param>
+		/// <returns>False if the worker is cancelled</returns>
+		bool QueueTask(const Task* task, std::unique_ptr<TaskExecPack>&& pack);
+
 		/// <summary>
 		/// Set all pending tasks to a Cancelled state
 		/// </summary>
@@ -125,7 +223,8 @@ namespace LuaWorker
 		/// Constructor
 		/// </summary>
 		/// <param name="log">Log to push errors and messages to</param>
-		Worker(LogSection &&log);
+		/// <param name="options">Settings for the worker's lua state</param>
+		Worker(LogSection &&log, const WorkerOptions& options = WorkerOptions());
 
 		/// <summary>
 		/// Destructor
@@ -144,6 +243,33 @@ namespace LuaWorker
 		/// <returns>Current worker status</returns>
 		WorkerStatus Stop();
 
+		/// <summary>
+		/// Stop running tasks, keeping the worker thread and its lua state, until Resume is called.
+		/// A task already running continues until it completes or yields.
+		/// </summary>
+		/// <returns>Current worker status</returns>
+		WorkerStatus Pause();
+
+		/// <summary>
+		/// Continue running tasks after Pause
+		/// </summary>
+		/// <returns>Current worker status</returns>
+		WorkerStatus Resume();
+
+		/// <summary>
+		/// Run the worker on a LuaStatePool thread, with the state parked there, until cancelled.
+		/// Called by LuaStatePool after Start hands this worker to it.
+		/// </summary>
+		/// <param name="lua">Open state</param>
+		void ThreadMainPooled(InnerLuaState& lua);
+
+		/// <summary>
+		/// Get the task which loads the preload modules and runs the init string of this worker.
+		/// It completes once the worker is ready, before the status becomes Processing.
+		/// </summary>
+		/// <returns>The task</returns>
+		std::shared_ptr<Task> GetReadyTask();
+
 		/// <summary>
 		/// Get current worker thread status
 		/// </summary>
@@ -164,6 +290,45 @@ namespace LuaWorker
 		/// <returns>Current worker status</returns>
 		WorkerStatus AddTask(std::shared_ptr<CoTask> task);
 
+		/// <summary>
+		/// Wake worker thread to check for coroutines waiting on input
+		/// Can be called from any thread
+		/// </summary>
+		void Wake();
+
+		/// <summary>
+		/// Take tasks added to this worker which have set a result or 
+		/// reached a final state since last polled. 
+		/// Only tasks added after the first call (or GetCompletionQueue) are queued.
+		/// </summary>
+		/// <param name="maxCount">Max number of tasks to return</param>
+		/// <returns>Tasks in the order they became ready</returns>
+		std::vector<std::shared_ptr<Task>> PollCompleted(std::size_t maxCount);
+
+		/// <summary>
+		/// Get the completion queue for tasks added to this worker.
+		/// Only tasks added after the first call (or PollCompleted) are queued.
+		/// </summary>
+		/// <returns>The queue</returns>
+		std::shared_ptr<TaskCompletionQueue> GetCompletionQueue();
+
+		/// <summary>
+		/// Get allocation counters for the worker's lua state. 
+		/// Empty if the lua state is not open.
+		/// </summary>
+		/// <returns>Stats snapshot</returns>
+		AllocatorStats GetMemoryStats();
+
+		//-------------------------------
+		// TaskObserver
+		//-------------------------------
+
+		/// <summary>
+		/// Unlink cancelled tasks from the queue, and interrupt them if running
+		/// </summary>
+		/// <param name="task">Task updated</param>
+		void OnTaskUpdated(const std::shared_ptr<Task>& task) override;
+
 		/// <summary>
 		/// Get log output for reading this worker's logs
 		/// </summary>
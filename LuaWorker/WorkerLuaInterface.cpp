@@ -16,12 +16,16 @@
 * 
 \*****************************************************************************/
 
+#include <algorithm>
+#include <cstdint>
+
 #include "WorkerLuaInterface.h"
 #include "TaskDoFile.h"
 #include "TaskDoString.h"
 #include "TaskDoSleep.h"
 #include "OneShotTask.h"
 #include "CoTask.h"
+#include "LuaStatePool.h"
 
 using namespace LuaWorker;
 using namespace AutoKeyDeck;
@@ -33,6 +37,8 @@ AutoKeyMap<lua_Integer, Worker> WorkerLuaInterface::sWorkers(0);
 
 lua_Integer WorkerLuaInterface::sNextWorkerId = 0;
 
+static const char* sStatePoolUserKey = "LUAWORKER_STATE_POOL_USER";
+
 //-------------------------------
 // Static Lua helper methods
 //-------------------------------
@@ -59,6 +65,117 @@ std::shared_ptr<Worker> WorkerLuaInterface::l_PopWorker(lua_State* pL, int& outK
 	}
 }
 
+void WorkerLuaInterface::l_ReadOptions(lua_State* pL, int index, WorkerOptions& options)
+{
+	lua_getfield(pL, index, "CancelMode");
+	if (lua_isnumber(pL, -1))
+	{
+		switch (lua_tointeger(pL, -1))
+		{
+		case CancelMode_Hook: options.cancelMode = CancelMode::Hook; break;
+		case CancelMode_Lazy: options.cancelMode = CancelMode::Lazy; break;
+		default: luaL_error(pL, "Invalid CancelMode!"); break;
+		}
+	}
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "IdleClose");
+	if (lua_isboolean(pL, -1)) options.idleClose = lua_toboolean(pL, -1) != 0;
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "IdleTimeoutMillis");
+	if (lua_isnumber(pL, -1)) options.idleTimeoutMillis = (unsigned int)std::max((lua_Integer)0, lua_tointeger(pL, -1));
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "Init");
+	if (lua_isstring(pL, -1)) options.init = lua_tostring(pL, -1);
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "IdleGC");
+	if (lua_isboolean(pL, -1)) options.idleGC = lua_toboolean(pL, -1) != 0;
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "Libs");
+	if (lua_istable(pL, -1))
+	{
+		options.libs.emplace();
+		for (int i = 1;; i++)
+		{
+			lua_rawgeti(pL, -1, i);
+			bool isLib = lua_isstring(pL, -1) != 0;
+			if (isLib)
+			{
+				const char* lib = lua_tostring(pL, -1);
+				if (!InnerLuaState::IsStandardLib(lib)) luaL_error(pL, "Invalid library name: %s!", lib);
+				options.libs->push_back(lib);
+			}
+			lua_pop(pL, 1);
+
+			if (!isLib) break;
+		}
+	}
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "MaxMemory");
+	if (lua_isnumber(pL, -1)) options.maxMemory = (std::size_t)std::max((lua_Integer)0, lua_tointeger(pL, -1));
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "PoolAllocator");
+	if (lua_isboolean(pL, -1)) options.poolAllocator = lua_toboolean(pL, -1) != 0;
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "Preload");
+	if (lua_istable(pL, -1))
+	{
+		for (int i = 1;; i++)
+		{
+			lua_rawgeti(pL, -1, i);
+			bool isModule = lua_isstring(pL, -1) != 0;
+			if (isModule) options.preload.push_back(lua_tostring(pL, -1));
+			lua_pop(pL, 1);
+
+			if (!isModule) break;
+		}
+	}
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "RecycleAboveBytes");
+	if (lua_isnumber(pL, -1)) options.recycleAboveBytes = (std::size_t)std::max((lua_Integer)0, lua_tointeger(pL, -1));
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "RecycleAfterMillis");
+	if (lua_isnumber(pL, -1)) options.recycleAfterMillis = (unsigned long)std::max((lua_Integer)0, lua_tointeger(pL, -1));
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "RecycleAfterTasks");
+	if (lua_isnumber(pL, -1)) options.recycleAfterTasks = (unsigned long)std::max((lua_Integer)0, lua_tointeger(pL, -1));
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "TimeSliceMillis");
+	if (lua_isnumber(pL, -1)) options.timeSliceMillis = (unsigned int)std::max((lua_Integer)0, lua_tointeger(pL, -1));
+	lua_pop(pL, 1);
+}
+
+void WorkerLuaInterface::l_ReadTaskOptions(lua_State* pL, int index, Task& task)
+{
+	unsigned long maxMillis = 0, maxInstructions = 0;
+	std::size_t maxMemory = 0;
+
+	lua_getfield(pL, index, "MaxMillis");
+	if (lua_isnumber(pL, -1)) maxMillis = (unsigned long)std::max((lua_Integer)0, lua_tointeger(pL, -1));
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "MaxInstructions");
+	if (lua_isnumber(pL, -1)) maxInstructions = (unsigned long)std::max((lua_Integer)0, lua_tointeger(pL, -1));
+	lua_pop(pL, 1);
+
+	lua_getfield(pL, index, "MaxMemory");
+	if (lua_isnumber(pL, -1)) maxMemory = (std::size_t)std::max((lua_Integer)0, lua_tointeger(pL, -1));
+	lua_pop(pL, 1);
+
+	task.SetBudget(TaskBudget(maxMillis, maxInstructions, maxMemory));
+}
+
 //-------------------------------
 // Static Lua-callable methods 
 // (Library level)
@@ -67,14 +184,18 @@ std::shared_ptr<Worker> WorkerLuaInterface::l_PopWorker(lua_State* pL, int& outK
 int WorkerLuaInterface::l_Worker_Create(lua_State* pL)
 {
 	lua_Integer logSize = 100;
-	if (lua_isnumber(pL, -1))
+	if (lua_isnumber(pL, 1))
 	{
-		logSize = lua_tointeger(pL, -1);
+		logSize = lua_tointeger(pL, 1);
 	}
 
+	WorkerOptions options;
+	if (lua_istable(pL, 2)) l_ReadOptions(pL, 2, options);
+	else if (lua_istable(pL, 1)) l_ReadOptions(pL, 1, options);
+
 	LogSection log(std::make_shared<LogStack>(logSize), "Worker " + std::to_string(sNextWorkerId++));
 
-	std::shared_ptr<Worker> newWorker(new Worker(std::move(log)));
+	std::shared_ptr<Worker> newWorker(new Worker(std::move(log), options));
 
 	lua_Integer key = sWorkers.push(newWorker);
 
@@ -105,11 +226,26 @@ int WorkerLuaInterface::l_Worker_Create(lua_State* pL)
 	lua_pushcclosure(pL, l_Worker_Stop, 1);
 	lua_setfield(pL, -2, "Stop");
 	lua_pushinteger(pL, key);
+	lua_pushcclosure(pL, l_Worker_Pause, 1);
+	lua_setfield(pL, -2, "Pause");
+	lua_pushinteger(pL, key);
+	lua_pushcclosure(pL, l_Worker_Resume, 1);
+	lua_setfield(pL, -2, "Resume");
+	lua_pushinteger(pL, key);
 	lua_pushcclosure(pL, l_Worker_Status, 1);
 	lua_setfield(pL, -2, "Status");
 	lua_pushinteger(pL, key);
 	lua_pushcclosure(pL, l_Worker_PopLogLine, 1);
 	lua_setfield(pL, -2, "PopLogLine");
+	lua_pushinteger(pL, key);
+	lua_pushcclosure(pL, l_Worker_PollCompleted, 1);
+	lua_setfield(pL, -2, "PollCompleted");
+	lua_pushinteger(pL, key);
+	lua_pushcclosure(pL, l_Worker_CompletionHandle, 1);
+	lua_setfield(pL, -2, "CompletionHandle");
+	lua_pushinteger(pL, key);
+	lua_pushcclosure(pL, l_Worker_MemoryStats, 1);
+	lua_setfield(pL, -2, "MemoryStats");
 
 	return 1;
 }
@@ -122,6 +258,44 @@ int WorkerLuaInterface::l_LuaWorker_Version(lua_State* pL)
 	return 3;
 }
 
+int WorkerLuaInterface::l_LuaWorker_SetStatePoolSize(lua_State* pL)
+{
+	if (!lua_isnumber(pL, 1)) return luaL_error(pL, "SetStatePoolSize expects a number!");
+
+	LuaStatePool::Instance().SetSize((std::size_t)std::max((lua_Integer)0, lua_tointeger(pL, 1)));
+
+	lua_pushinteger(pL, (lua_Integer)LuaStatePool::Instance().GetParkedCount());
+	return 1;
+}
+
+void WorkerLuaInterface::l_AddStatePoolUser(lua_State* pL)
+{
+	lua_pushlightuserdata(pL, &sStatePoolUserKey);
+	lua_gettable(pL, LUA_REGISTRYINDEX);
+	bool registered = !lua_isnil(pL, -1);
+	lua_pop(pL, 1);
+
+	if (registered) return;
+
+	// Pool threads are joined when this state closes, rather than at process exit
+	lua_pushlightuserdata(pL, &sStatePoolUserKey);
+	lua_newuserdata(pL, 1);
+	lua_createtable(pL, 0, 1);
+	lua_pushcfunction(pL, l_StatePoolUser_Delete);
+	lua_setfield(pL, -2, "__gc");
+	lua_setmetatable(pL, -2);
+	lua_settable(pL, LUA_REGISTRYINDEX);
+
+	LuaStatePool::Instance().AddUser();
+}
+
+int WorkerLuaInterface::l_StatePoolUser_Delete(lua_State* pL)
+{
+	// The registry userdata added by l_AddStatePoolUser, one per lua state
+	if (lua_touserdata(pL, 1) != nullptr) LuaStatePool::Instance().RemoveUser();
+	return 0;
+}
+
 //-------------------------------
 // Static Lua-callable methods 
 // (Worker Object)
@@ -145,11 +319,12 @@ int WorkerLuaInterface::l_Worker_DoString(lua_State* pL)
 
 	if (pWorker != nullptr)
 	{
-		if (lua_isstring(pL, -1))
+		if (lua_isstring(pL, 2))
 		{
-			std::string str = lua_tostring(pL, -1);
+			std::string str = lua_tostring(pL, 2);
 
 			std::shared_ptr<OneShotTask> newItem(new TaskDoString(str));
+			if (lua_istable(pL, 3)) l_ReadTaskOptions(pL, 3, *newItem);
 			pWorker->AddTask(newItem);
 
 			return TaskLuaInterface::l_PushTask(pL, newItem);
@@ -165,11 +340,12 @@ int WorkerLuaInterface::l_Worker_DoFile(lua_State* pL)
 
 	if (pWorker != nullptr)
 	{
-		if (lua_isstring(pL, -1))
+		if (lua_isstring(pL, 2))
 		{
-			std::string str = lua_tostring(pL, -1);
+			std::string str = lua_tostring(pL, 2);
 
 			std::shared_ptr<OneShotTask> newItem(new TaskDoFile(str));
+			if (lua_istable(pL, 3)) l_ReadTaskOptions(pL, 3, *newItem);
 			pWorker->AddTask(newItem);
 			
 			return TaskLuaInterface::l_PushTask(pL, newItem);
@@ -220,6 +396,7 @@ int WorkerLuaInterface::l_Worker_DoCoRoutine(lua_State* pL)
 		}
 
 		std::shared_ptr<CoTask> newItem(new CoTask(funcStr, argStrings));
+		if (lua_istable(pL, -1)) l_ReadTaskOptions(pL, -1, *newItem);
 		pWorker->AddTask(newItem);
 
 		return TaskLuaInterface::l_PushTask(pL, newItem);
@@ -247,6 +424,7 @@ int WorkerLuaInterface::l_PushStatus(lua_State* pL, std::shared_ptr<Worker> pWor
 	{
 	case WorkerStatus::Cancelled:	statusInt = WorkerStatus_Cancelled;		break;
 	case WorkerStatus::Processing:	statusInt = WorkerStatus_Processing;	break;
+	case WorkerStatus::Paused:		statusInt = WorkerStatus_Paused;		break;
 	case WorkerStatus::Starting:	statusInt = WorkerStatus_Starting;		break;
 	case WorkerStatus::Error:		statusInt = WorkerStatus_Error;			break;
 	default:						statusInt = WorkerStatus_NotStarted;	break;
@@ -261,9 +439,14 @@ int WorkerLuaInterface::l_Worker_Start(lua_State* pL)
 {
 	std::shared_ptr<Worker> pWorker = l_PopWorker(pL);
 
-	if (pWorker != nullptr) pWorker->Start();
+	if (pWorker == nullptr) return 0;
 
-	return l_PushStatus(pL, pWorker);
+	pWorker->Start();
+
+	l_PushStatus(pL, pWorker);
+	TaskLuaInterface::l_PushTask(pL, pWorker->GetReadyTask());
+
+	return 2;
 }
 
 int WorkerLuaInterface::l_Worker_Stop(lua_State* pL)
@@ -275,6 +458,24 @@ int WorkerLuaInterface::l_Worker_Stop(lua_State* pL)
 	return l_PushStatus(pL, pWorker);
 }
 
+int WorkerLuaInterface::l_Worker_Pause(lua_State* pL)
+{
+	std::shared_ptr<Worker> pWorker = l_PopWorker(pL);
+
+	if (pWorker != nullptr) pWorker->Pause();
+
+	return l_PushStatus(pL, pWorker);
+}
+
+int WorkerLuaInterface::l_Worker_Resume(lua_State* pL)
+{
+	std::shared_ptr<Worker> pWorker = l_PopWorker(pL);
+
+	if (pWorker != nullptr) pWorker->Resume();
+
+	return l_PushStatus(pL, pWorker);
+}
+
 int WorkerLuaInterface::l_Worker_PopLogLine(lua_State* pL)
 {
 	std::shared_ptr<Worker> pWorker = l_PopWorker(pL);
@@ -303,3 +504,72 @@ int WorkerLuaInterface::l_Worker_PopLogLine(lua_State* pL)
 
 	return 0;
 }
+
+int WorkerLuaInterface::l_Worker_PollCompleted(lua_State* pL)
+{
+	std::shared_ptr<Worker> pWorker = l_PopWorker(pL);
+
+	if (pWorker == nullptr) return 0;
+
+	std::size_t maxCount = SIZE_MAX;
+	if (lua_isnumber(pL, 2)) maxCount = (std::size_t)std::max((lua_Integer)0, lua_tointeger(pL, 2));
+
+	std::vector<std::shared_ptr<Task>> tasks = pWorker->PollCompleted(maxCount);
+
+	lua_createtable(pL, (int)tasks.size(), 0);
+
+	int i = 1;
+	for (const std::shared_ptr<Task>& task : tasks)
+	{
+		TaskLuaInterface::l_PushTaskHandle(pL, task);
+		lua_rawseti(pL, -2, i++);
+	}
+
+	return 1;
+}
+
+int WorkerLuaInterface::l_Worker_CompletionHandle(lua_State* pL)
+{
+	std::shared_ptr<Worker> pWorker = l_PopWorker(pL);
+
+	if (pWorker == nullptr) return 0;
+
+	std::shared_ptr<TaskCompletionQueue> pQueue = pWorker->GetCompletionQueue();
+
+	if (!pQueue->HasSignalHandle()) return 0;
+
+#ifdef _WIN32
+	lua_pushlightuserdata(pL, pQueue->GetSignalHandle());
+#else
+	lua_pushinteger(pL, (lua_Integer)pQueue->GetSignalHandle());
+#endif
+
+	return 1;
+}
+
+int WorkerLuaInterface::l_Worker_MemoryStats(lua_State* pL)
+{
+	std::shared_ptr<Worker> pWorker = l_PopWorker(pL);
+
+	if (pWorker == nullptr) return 0;
+
+	AllocatorStats stats = pWorker->GetMemoryStats();
+
+	lua_createtable(pL, 0, 7);
+	lua_pushinteger(pL, (lua_Integer)stats.bytesInUse);
+	lua_setfield(pL, -2, "BytesInUse");
+	lua_pushinteger(pL, (lua_Integer)stats.peakBytesInUse);
+	lua_setfield(pL, -2, "PeakBytesInUse");
+	lua_pushinteger(pL, (lua_Integer)stats.allocations);
+	lua_setfield(pL, -2, "Allocations");
+	lua_pushinteger(pL, (lua_Integer)stats.pooledAllocations);
+	lua_setfield(pL, -2, "PooledAllocations");
+	lua_pushinteger(pL, (lua_Integer)stats.arenaBytes);
+	lua_setfield(pL, -2, "ArenaBytes");
+	lua_pushinteger(pL, (lua_Integer)stats.maxBytes);
+	lua_setfield(pL, -2, "MaxMemory");
+	lua_pushinteger(pL, (lua_Integer)stats.failedAllocations);
+	lua_setfield(pL, -2, "FailedAllocations");
+
+	return 1;
+}
@@ -79,6 +79,22 @@ namespace LuaWorker
 		/// <returns>Number of items pushed to the stack</returns>
 		static int l_PushStatus(lua_State* pL, std::shared_ptr<Worker> pWorker);
 
+		/// <summary>
+		/// Read worker options from a table on the lua stack
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="index">Stack index of the options table</param>
+		/// <param name="options">Options to update</param>
+		static void l_ReadOptions(lua_State* pL, int index, WorkerOptions& options);
+
+		/// <summary>
+		/// Read per-task options from a table on the lua stack
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <param name="index">Stack index of the options table</param>
+		/// <param name="task">Task to apply the options to</param>
+		static void l_ReadTaskOptions(lua_State* pL, int index, Task& task);
+
 	public:
 
 		//-------------------------------
@@ -89,13 +105,18 @@ namespace LuaWorker
 			WorkerStatus_Starting = 1,
 			WorkerStatus_Processing = 2,
 			WorkerStatus_Cancelled = 3,
-			WorkerStatus_Error = 4;
+			WorkerStatus_Error = 4,
+			WorkerStatus_Paused = 5;
 
 		static const int
 			LogLevel_Info = 0,
 			LogLevel_Warn = 1,
 			LogLevel_Error = 2;
 
+		static const int
+			CancelMode_Hook = 0,
+			CancelMode_Lazy = 1;
+
 		static const int
 			LuaWorkerVersion_Major = 1,
 			LuaWorkerVersion_Minor = 1,
@@ -110,7 +131,7 @@ namespace LuaWorker
 		/// Create a new worker instance
 		/// 
 		/// Lua syntax:
-		///		local worker = LuaWorker.Create()
+		///		local worker = LuaWorker.Create(logSize, {CancelMode = LuaWorker.CancelMode.Lazy})
 		/// </summary>
 		/// <param name="pL">Lua state</param>
 		/// <returns>Number of items pushed to the stack</returns>
@@ -124,6 +145,33 @@ namespace LuaWorker
 		/// </summary>
 		static int l_LuaWorker_Version(lua_State* pL);
 
+		/// <summary>
+		/// Set the number of lua states kept open by the process-wide state pool, for workers 
+		/// with default options to adopt on Start. 0 (the default) disables the pool.
+		/// Returns the number of states currently parked.
+		///
+		/// Lua syntax:
+		///		local parked = LuaWorker.SetStatePoolSize(4)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_LuaWorker_SetStatePoolSize(lua_State* pL);
+
+		/// <summary>
+		/// Register the calling lua state as a user of the state pool, 
+		/// until a sentinel object left in its registry is collected.
+		/// Call once when the library is opened.
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		static void l_AddStatePoolUser(lua_State* pL);
+
+		/// <summary>
+		/// __gc of the state pool sentinel
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_StatePoolUser_Delete(lua_State* pL);
+
 
 		//-------------------------------
 		// Static Lua-callable methods 
@@ -142,7 +190,10 @@ namespace LuaWorker
 		/// Add executable string task to the worker queue.
 		/// 
 		/// Lua syntax:
-		///		local task = worker:DoString("os.execute('timeout 5')")
+		///		local task = worker:DoString("while true do end", {MaxMillis = 1000})
+		/// 
+		/// MaxMillis is checked from the lua hook, so time spent in a C function (e.g. os.execute)
+		/// is only checked once control returns to lua.
 		/// </summary>
 		/// <param name="pL">Lua state</param>
 		/// <returns>Number of items pushed to the stack</returns>
@@ -152,7 +203,7 @@ namespace LuaWorker
 		/// Add executable file task to the worker queue.
 		/// 
 		/// Lua syntax:
-		///		local task = worker:DoFile("myfile.lua")
+		///		local task = worker:DoFile("myfile.lua", {MaxInstructions = 1e6})
 		/// </summary>
 		/// <param name="pL">Lua state</param>
 		/// <returns>Number of items pushed to the stack</returns>
@@ -172,17 +223,17 @@ namespace LuaWorker
 		/// Add starting a coroutine to the worker queue.
 		/// 
 		/// Lua syntax:
-		///		local task = worker:DoCoroutine("functionToCall","arg1","arg2",...)
+		///		local task = worker:DoCoroutine("functionToCall","arg1","arg2",...,{MaxMillis = 1000})
 		/// </summary>
 		/// <param name="pL">Lua state</param>
 		/// <returns>Number of items pushed to the stack</returns>
 		static int l_Worker_DoCoRoutine(lua_State* pL);
 
 		/// <summary>
-		/// Start worker thread
+		/// Start worker thread. Also returns the task which completes when the worker is ready.
 		/// 
 		/// Lua syntax:
-		///		local status = worker:Start()
+		///		local status, readyTask = worker:Start()
 		/// </summary>
 		/// <param name="pL">Lua state</param>
 		/// <returns>Number of items pushed to the stack</returns>
@@ -199,6 +250,26 @@ namespace LuaWorker
 		/// <returns>Number of items pushed to the stack</returns>
 		static int l_Worker_Stop(lua_State* pL);
 
+		/// <summary>
+		/// Stop running tasks, keeping the worker's lua state, until resumed
+		/// 
+		/// Lua syntax:
+		///		local status = worker:Pause()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Worker_Pause(lua_State* pL);
+
+		/// <summary>
+		/// Continue running tasks on a paused worker
+		/// 
+		/// Lua syntax:
+		///		local status = worker:Resume()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Worker_Resume(lua_State* pL);
+
 		/// <summary>
 		/// Get current status of a worker
 		/// 
@@ -218,6 +289,43 @@ namespace LuaWorker
 		/// <param name="pL">Lua state</param>
 		/// <returns>Number of items pushed to the stack</returns>
 		static int l_Worker_PopLogLine(lua_State* pL);
+
+		/// <summary>
+		/// Get handles of tasks on this worker which have a result or 
+		/// reached a final state since last polled (oldest first).
+		/// Only tasks added after the first call (or CompletionHandle) are returned.
+		/// 
+		/// Lua syntax:
+		///		local tasks = worker:PollCompleted(maxCount)
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Worker_PollCompleted(lua_State* pL);
+
+		/// <summary>
+		/// Get an OS handle which is signalled while PollCompleted has 
+		/// tasks to return: a file descriptor (integer) on Linux, or an
+		/// event HANDLE (light userdata) on Windows
+		/// 
+		/// Lua syntax:
+		///		local fd = worker:CompletionHandle()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Worker_CompletionHandle(lua_State* pL);
+
+		/// <summary>
+		/// Get allocation counters for the worker's lua state, as a table with fields
+		/// BytesInUse, PeakBytesInUse, Allocations, PooledAllocations, ArenaBytes, 
+		/// MaxMemory and FailedAllocations.
+		/// All zero if the worker is not running.
+		/// 
+		/// Lua syntax:
+		///		local stats = worker:MemoryStats()
+		/// </summary>
+		/// <param name="pL">Lua state</param>
+		/// <returns>Number of items pushed to the stack</returns>
+		static int l_Worker_MemoryStats(lua_State* pL);
 	};
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,100 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#ifndef _WORKER_OPTIONS_H_
+#define _WORKER_OPTIONS_H_
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace LuaWorker
+{
+	/// <summary>
+	/// How running lua is interrupted when a worker is cancelled
+	/// </summary>
+	enum class CancelMode {
+		Hook,	// Call and count hook installed for the life of the lua state
+		Lazy	// No hook until cancelled, then a count hook on the running thread
+	};
+
+	/// <summary>
+	/// Settings fixed when a worker is created
+	/// </summary>
+	struct WorkerOptions
+	{
+		CancelMode cancelMode = CancelMode::Hook;
+
+		// Max time a coroutine task runs before being suspended and requeued. 0 for no limit.
+		unsigned int timeSliceMillis = 0;
+
+		// Serve small lua allocations from a pool owned by the worker, rather than the system allocator
+		bool poolAllocator = true;
+
+		// Max bytes allocated by the lua state while tasks run. 0 for no limit.
+		std::size_t maxMemory = 0;
+
+		// Run incremental garbage collection while the worker has nothing to do
+		bool idleGC = false;
+
+		// Time without tasks after which the worker collects all garbage. 0 to disable.
+		unsigned int idleTimeoutMillis = 0;
+
+		// Close the lua state after the idle timeout, reopening it for the next task
+		bool idleClose = false;
+
+		// Replace the lua state with a fresh one, prepared on a helper thread, after this many tasks. 0 for never.
+		unsigned long recycleAfterTasks = 0;
+
+		// Replace the lua state after it has been open this long. 0 for never.
+		unsigned long recycleAfterMillis = 0;
+
+		// Replace the lua state once the larger of its bytes in use and its arena bytes exceeds this. 0 for never.
+		std::size_t recycleAboveBytes = 0;
+
+		// Standard libraries to open with the lua state. Others open on first access. All if not set.
+		std::optional<std::vector<std::string>> libs;
+
+		// Modules to require when the lua state opens, before the worker reports Processing
+		std::vector<std::string> preload;
+
+		// Lua string to run after preloading modules. Empty for none.
+		std::string init;
+
+		bool operator==(const WorkerOptions& other) const
+		{
+			return cancelMode == other.cancelMode
+				&& timeSliceMillis == other.timeSliceMillis
+				&& poolAllocator == other.poolAllocator
+				&& maxMemory == other.maxMemory
+				&& idleGC == other.idleGC
+				&& idleTimeoutMillis == other.idleTimeoutMillis
+				&& idleClose == other.idleClose
+				&& recycleAfterTasks == other.recycleAfterTasks
+				&& recycleAfterMillis == other.recycleAfterMillis
+				&& recycleAboveBytes == other.recycleAboveBytes
+				&& libs == other.libs
+				&& preload == other.preload
+				&& init == other.init;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
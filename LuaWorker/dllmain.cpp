@@ -20,6 +20,8 @@
 
 #include "WorkerLuaInterface.h"
 #include "TaskLuaInterface.h"
+#include "CacheLuaInterface.h"
+#include "CounterLuaInterface.h"
 
 extern "C" {
     #include "lua.h"
@@ -33,11 +35,20 @@ extern "C"  int luaopen_LuaWorker(lua_State* pL) {
     static const luaL_Reg Worker_Index[] = {
           {"Create", WorkerLuaInterface::l_Worker_Create},
           {"Version", WorkerLuaInterface::l_LuaWorker_Version},
+          {"AwaitAny", TaskLuaInterface::l_LuaWorker_AwaitAny},
+          {"AwaitAll", TaskLuaInterface::l_LuaWorker_AwaitAll},
+          {"Pump", TaskLuaInterface::l_LuaWorker_Pump},
+          {"SetStatePoolSize", WorkerLuaInterface::l_LuaWorker_SetStatePoolSize},
+          {"SharedCache", CacheLuaInterface::l_LuaWorker_SharedCache},
+          {"Snapshot", CacheLuaInterface::l_LuaWorker_Snapshot},
+          {"Counter", CounterLuaInterface::l_LuaWorker_Counter},
 
           {nullptr, nullptr}  /* end */
     };
     luaL_register(pL, "LuaWorker", Worker_Index);
 
+    WorkerLuaInterface::l_AddStatePoolUser(pL);
+
     // Add Enums
 
     //Task Status
@@ -68,8 +79,18 @@ extern "C"  int luaopen_LuaWorker(lua_State* pL) {
         lua_setfield(pL, -2, "Cancelled");
             lua_pushnumber(pL, WorkerLuaInterface::WorkerStatus_Error);
         lua_setfield(pL, -2, "Error");
+            lua_pushnumber(pL, WorkerLuaInterface::WorkerStatus_Paused);
+        lua_setfield(pL, -2, "Paused");
     lua_setfield(pL, -2, "WorkerStatus");
 
+    //Cancel Mode
+        lua_createtable(pL, 0, 2);
+            lua_pushnumber(pL, WorkerLuaInterface::CancelMode_Hook);
+        lua_setfield(pL, -2, "Hook");
+            lua_pushnumber(pL, WorkerLuaInterface::CancelMode_Lazy);
+        lua_setfield(pL, -2, "Lazy");
+    lua_setfield(pL, -2, "CancelMode");
+
     //Log Level
     lua_createtable(pL, 0, 4);
         lua_pushnumber(pL, WorkerLuaInterface::LogLevel_Info);
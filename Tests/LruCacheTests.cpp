@@ -0,0 +1,142 @@
+/*****************************************************************************\
+*
+*  Copyright 2023 HappyGnome
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+\*****************************************************************************/
+
+#include "CppUnitTest.h"
+#include "LruCache.h"
+
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace AutoKeyDeck;
+
+namespace Tests
+{
+	/// <summary>
+	/// Clock advanced manually by tests
+	/// </summary>
+	class FakeClock
+	{
+	public:
+		typedef std::chrono::milliseconds duration;
+		typedef duration::rep rep;
+		typedef duration::period period;
+		typedef std::chrono::time_point<FakeClock> time_point;
+		static const bool is_steady = true;
+
+		static time_point sNow;
+
+		static time_point now() { return sNow; }
+	};
+
+	FakeClock::time_point FakeClock::sNow{};
+
+	TEST_CLASS(LruCacheTests)
+	{
+	public:
+
+		TEST_METHOD(EmptyCache)
+		{
+			LruCache<int, std::string> cache(2);
+
+			Assert::IsNull(cache.Get(1));
+			Assert::AreEqual(cache.GetStats().misses, (size_t)1);
+		}
+
+		TEST_METHOD(LeastRecentlyUsedEvicted)
+		{
+			LruCache<int, std::string> cache(2);
+
+			cache.Set(1, "one");
+			cache.Set(2, "two");
+
+			Assert::IsNotNull(cache.Get(1));// 2 is now least recent
+			cache.Set(3, "three");
+
+			Assert::IsNull(cache.Get(2));
+			Assert::AreEqual(*cache.Get(1), std::string("one"));
+			Assert::AreEqual(*cache.Get(3), std::string("three"));
+
+			LruCacheStats stats = cache.GetStats();
+			Assert::AreEqual(stats.hits, (size_t)3);
+			Assert::AreEqual(stats.misses, (size_t)1);
+			Assert::AreEqual(stats.evictions, (size_t)1);
+			Assert::AreEqual(stats.size, (size_t)2);
+		}
+
+		TEST_METHOD(OverwriteAndRemove)
+		{
+			LruCache<int, std::string> cache(2);
+
+			cache.Set(1, "one");
+			cache.Set(1, "uno");
+			Assert::AreEqual(cache.Size(), (size_t)1);
+			Assert::AreEqual(*cache.Get(1), std::string("uno"));
+
+			Assert::IsTrue(cache.Remove(1));
+			Assert::IsFalse(cache.Remove(1));
+			Assert::IsNull(cache.Get(1));
+
+			cache.Set(2, "two");
+			cache.Clear();
+			Assert::AreEqual(cache.Size(), (size_t)0);
+		}
+
+		TEST_METHOD(WeightedEntries)
+		{
+			LruCache<int, std::string> cache(10);
+
+			Assert::IsTrue(cache.Set(1, "a", 4));
+			Assert::IsTrue(cache.Set(2, "b", 4));
+			Assert::IsTrue(cache.Set(3, "c", 4));// Evicts 1
+
+			Assert::IsNull(cache.Get(1));
+			Assert::AreEqual(cache.GetStats().weight, (size_t)8);
+
+			Assert::IsTrue(cache.Set(2, "bb", 6));// Replaces 2's weight
+			Assert::AreEqual(cache.GetStats().weight, (size_t)10);
+			Assert::AreEqual(cache.Size(), (size_t)2);
+
+			Assert::IsFalse(cache.Set(3, "too big", 11));
+			Assert::IsNull(cache.Get(3));
+			Assert::AreEqual(*cache.Get(2), std::string("bb"));
+			Assert::AreEqual(cache.GetStats().weight, (size_t)6);
+		}
+
+		TEST_METHOD(EntriesExpire)
+		{
+			LruCache<int, int, FakeClock> cache(4, std::chrono::milliseconds(100));
+
+			cache.Set(1, 10);
+			FakeClock::sNow += std::chrono::milliseconds(60);
+			cache.Set(2, 20);
+
+			Assert::AreEqual(*cache.Get(1), 10);
+
+			FakeClock::sNow += std::chrono::milliseconds(60);
+			Assert::IsNull(cache.Get(1));
+			Assert::AreEqual(*cache.Get(2), 20);
+
+			FakeClock::sNow += std::chrono::milliseconds(60);
+			Assert::IsNull(cache.Get(2));
+
+			LruCacheStats stats = cache.GetStats();
+			Assert::AreEqual(stats.expirations, (size_t)2);
+			Assert::AreEqual(stats.size, (size_t)0);
+		}
+	};
+}
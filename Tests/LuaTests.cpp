@@ -222,6 +222,387 @@ namespace Tests
 			std::this_thread::sleep_for(0.5s);
 			Assert::IsFalse(lua.DoTestString("return Step5()", 200ms), L"Step5");
 		}
+
+		TEST_METHOD(EmitDrain)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("EmitDrain.lua");
+
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step1()", 500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 500ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 200ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 200ms), L"Step4");
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step5()", 200ms), L"Step5");
+		}
+
+		TEST_METHOD(StreamingInput)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("StreamingInput.lua");
+
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step1()", 500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 300ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 200ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 500ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 200ms), L"Step5");
+			Assert::IsTrue(lua.DoTestString("return Step6()", 300ms, 100ms), L"Step6");
+		}
+
+		TEST_METHOD(AwaitMany)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("AwaitMany.lua");
+
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step1()", 200ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 500ms, 150ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 1200ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 300ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 200ms), L"Step5");
+		}
+
+		TEST_METHOD(PollCompleted)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("PollCompleted.lua");
+
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step1()", 500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 500ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 200ms), L"Step3");
+			std::this_thread::sleep_for(0.3s);
+			Assert::IsTrue(lua.DoTestString("return Step4()", 200ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 200ms), L"Step5");
+			Assert::IsTrue(lua.DoTestString("return Step6()", 3000ms), L"Step6");
+		}
+
+		TEST_METHOD(PumpCallbacks)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("PumpCallbacks.lua");
+
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step1()", 500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 200ms), L"Step2");
+			std::this_thread::sleep_for(0.1s);
+			Assert::IsTrue(lua.DoTestString("return Step3()", 200ms), L"Step3");
+			std::this_thread::sleep_for(0.4s);
+			Assert::IsTrue(lua.DoTestString("return Step4()", 200ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 600ms), L"Step5");
+		}
+
+		TEST_METHOD(PumpTwoStates)
+		{
+			LuaTestState luaA;
+			LuaTestState luaB;
+
+			luaA.DoTestFile("Common.lua");
+			luaA.DoTestFile("PumpTwoStates.lua");
+			luaB.DoTestFile("Common.lua");
+			luaB.DoTestFile("PumpTwoStates.lua");
+
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(luaB.DoTestString("return Register()", 600ms), L"RegisterB");
+			Assert::IsTrue(luaA.DoTestString("return PumpOther()", 300ms), L"PumpOtherA");
+			Assert::IsTrue(luaB.DoTestString("return PumpOwn()", 600ms), L"PumpOwnB");
+		}
+
+		TEST_METHOD(AwaitAsync)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("AwaitAsync.lua");
+
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step1()", 500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 200ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 200ms), L"Step3");
+			std::this_thread::sleep_for(0.1s);
+			Assert::IsTrue(lua.DoTestString("return Step4()", 200ms), L"Step4");
+			std::this_thread::sleep_for(0.4s);
+			Assert::IsTrue(lua.DoTestString("return Step5()", 500ms), L"Step5");
+			Assert::IsTrue(lua.DoTestString("return Step6()", 600ms), L"Step6");
+			Assert::IsTrue(lua.DoTestString("return Step7()", 200ms), L"Step7");
+		}
+
+		TEST_METHOD(LazyCancel)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("LazyCancel.lua");
+
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step1()", 500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 500ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 1500ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 1000ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 1000ms), L"Step5");
+			Assert::IsTrue(lua.DoTestString("return Step6()", 1000ms), L"Step6");
+			Assert::IsTrue(lua.DoTestString("return Step7()", 200ms), L"Step7");
+		}
+
+		TEST_METHOD(TaskBudget)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("TaskBudget.lua");
+
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step1()", 500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 1500ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 1000ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 1000ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 200ms), L"Step5");
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step6()", 200ms), L"Step6");
+		}
+
+		TEST_METHOD(TaskCancel)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("TaskCancel.lua");
+
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step1()", 500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 1000ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 1500ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 600ms), L"Step4");
+			std::this_thread::sleep_for(0.3s);
+			Assert::IsTrue(lua.DoTestString("return Step5()", 200ms), L"Step5");
+			Assert::IsTrue(lua.DoTestString("return Step6()", 1500ms), L"Step6");
+		}
+
+		TEST_METHOD(TimeSlice)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("TimeSlice.lua");
+
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step1()", 500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 1000ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 1000ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 1000ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 1000ms), L"Step5");
+		}
+
+		TEST_METHOD(MemoryStats)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("MemoryStats.lua");
+
+			Assert::IsTrue(lua.DoTestString("return Step1()", 200ms), L"Step1");
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step2()", 500ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 500ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 1000ms), L"Step4");
+		}
+
+		TEST_METHOD(MemoryLimit)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("MemoryLimit.lua");
+
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step1()", 200ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 1500ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 1000ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 500ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 3000ms), L"Step5");
+		}
+
+		TEST_METHOD(IdleGC)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("IdleGC.lua");
+
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step1()", 200ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 1000ms), L"Step2");
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step3()", 200ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 500ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 500ms), L"Step5");
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step6()", 500ms), L"Step6");
+		}
+
+		TEST_METHOD(StatePool)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("StatePool.lua");
+
+			Assert::IsTrue(lua.DoTestString("return Step1()", 200ms), L"Step1");
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step2()", 500ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 500ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 1500ms), L"Step4");
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step5()", 200ms), L"Step5");
+		}
+
+		TEST_METHOD(InitChunk)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("InitChunk.lua");
+
+			Assert::IsTrue(lua.DoTestString("return Step1()", 1500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 1000ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 1500ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 500ms), L"Step4");
+		}
+
+		TEST_METHOD(Libs)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("Libs.lua");
+
+			Assert::IsTrue(lua.DoTestString("return Step1()", 1500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 1000ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 1000ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 1000ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 200ms), L"Step5");
+		}
+
+		TEST_METHOD(PauseResume)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("PauseResume.lua");
+
+			Assert::IsTrue(lua.DoTestString("return Step1()", 1500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 500ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 1000ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 500ms), L"Step4");
+		}
+
+		TEST_METHOD(IdleHibernate)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("IdleHibernate.lua");
+
+			Assert::IsTrue(lua.DoTestString("return Step1()", 2500ms), L"Step1");
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step2()", 200ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 1500ms), L"Step3");
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step4()", 1000ms), L"Step4");
+		}
+
+		TEST_METHOD(Recycle)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("Recycle.lua");
+
+			Assert::IsTrue(lua.DoTestString("return Step1()", 2500ms), L"Step1");
+			std::this_thread::sleep_for(0.5s);
+			Assert::IsTrue(lua.DoTestString("return Step2()", 1000ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 500ms), L"Step3");
+		}
+
+		TEST_METHOD(CoroutineThreadReuse)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("CoroutineThreadReuse.lua");
+
+			Assert::IsTrue(lua.DoTestString("return Step1()", 5000ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 10000ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 3000ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 2000ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 2000ms), L"Step5");
+		}
+
+		TEST_METHOD(Cache)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("CacheTest.lua");
+
+			Assert::IsTrue(lua.DoTestString("return Step1()", 1000ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 1000ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 1000ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 1500ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 1000ms), L"Step5");
+		}
+
+		TEST_METHOD(SharedCache)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("SharedCache.lua");
+
+			Assert::IsTrue(lua.DoTestString("return Step1()", 1500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 200ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 500ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 200ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 1000ms), L"Step5");
+		}
+
+		TEST_METHOD(Snapshot)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("Snapshot.lua");
+
+			Assert::IsTrue(lua.DoTestString("return Step1()", 1500ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 1000ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 200ms), L"Step3");
+			Assert::IsTrue(lua.DoTestString("return Step4()", 1000ms), L"Step4");
+			Assert::IsTrue(lua.DoTestString("return Step5()", 1000ms), L"Step5");
+		}
+
+		TEST_METHOD(Counters)
+		{
+			LuaTestState lua;
+
+			lua.DoTestFile("Common.lua");
+			lua.DoTestFile("Counters.lua");
+
+			Assert::IsTrue(lua.DoTestString("return Step1()", 2000ms), L"Step1");
+			Assert::IsTrue(lua.DoTestString("return Step2()", 200ms), L"Step2");
+			Assert::IsTrue(lua.DoTestString("return Step3()", 1000ms), L"Step3");
+		}
 		
 	};
 }
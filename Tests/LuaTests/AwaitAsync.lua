@@ -0,0 +1,101 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+initStr = [[
+TwoStepFunc = function()
+	InLuaWorker.YieldFor(200, "first")
+	return "second"
+end]]
+
+w = LuaWorker.Create()
+w:Start()
+
+Trace = {}
+
+Step1 = function()
+	w:DoString(initStr):Await(500)
+
+	RaiseFirstWorkerError(w)
+	
+	return w:Status() == LuaWorker.WorkerStatus.Processing
+end 
+
+-- Main thread cannot yield
+Step2 = function()
+	local ok = pcall(function() w:DoSleep(1):AwaitAsync() end)
+
+	return not ok
+end 
+
+Step3 = function()
+	T = w:DoCoroutine("TwoStepFunc")
+
+	Co = coroutine.create(function()
+		Trace[#Trace + 1] = T:AwaitAsync()
+		Trace[#Trace + 1] = T:AwaitAsync()
+		Trace[#Trace + 1] = w:DoString("error('x')"):AwaitAsync() or "error"
+	end)
+
+	local ok = coroutine.resume(Co)
+
+	RaiseFirstWorkerError(w)
+	return ok and coroutine.status(Co) == "suspended"
+end 
+
+-- After ~0.1s: first yield delivered by Pump
+Step4 = function()
+	LuaWorker.Pump(10)
+
+	return #Trace == 1 and Trace[1] == "first" and coroutine.status(Co) == "suspended"
+end 
+
+-- After ~0.4s: completion, then errored task
+Step5 = function()
+	local t0 = os.clock()
+	while coroutine.status(Co) ~= "dead" and os.clock() - t0 < 0.3 do
+		LuaWorker.Pump(10)
+	end
+
+	return #Trace == 3 and Trace[2] == "second" and Trace[3] == "error" 
+		and coroutine.status(Co) == "dead"
+end 
+
+-- Result available already: no yield
+Step6 = function()
+	local t = w:DoString("return 'now'")
+	t:Await(500)
+
+	local res
+	local co = coroutine.create(function() res = t:AwaitAsync() end)
+	coroutine.resume(co)
+
+	return res == "now" and coroutine.status(co) == "dead"
+end 
+
+-- Final without completing: nil, as when resumed by Pump
+Step7 = function()
+	w:DoSleep(300)
+	local t = w:DoString("return 'never'")
+	t:Cancel()
+
+	local res = "unset"
+	local co = coroutine.create(function() res = t:AwaitAsync() end)
+	coroutine.resume(co)
+
+	return t:Status() == LuaWorker.TaskStatus.Cancelled and res == nil and coroutine.status(co) == "dead"
+end 
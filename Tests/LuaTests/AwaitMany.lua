@@ -0,0 +1,65 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+w1 = LuaWorker.Create()
+w2 = LuaWorker.Create()
+w1:Start()
+w2:Start()
+
+Step1 = function()
+	RaiseFirstWorkerError(w1)
+	RaiseFirstWorkerError(w2)
+	
+	return w1:Status() == LuaWorker.WorkerStatus.Processing
+		and w2:Status() == LuaWorker.WorkerStatus.Processing
+end 
+
+-- Returns as soon as the shorter task completes
+Step2 = function()
+	T1 = w1:DoSleep(200)
+	T2 = w2:DoSleep(1000)
+
+	local ready = LuaWorker.AwaitAny({T2, T1}, 800)
+
+	RaiseFirstWorkerError(w1)
+	RaiseFirstWorkerError(w2)
+	return #ready == 1 and ready[1] == T1
+end 
+
+-- Returns once both complete, handles in the order given
+Step3 = function()
+	local ready = LuaWorker.AwaitAll({T1, T2}, 1500)
+
+	return #ready == 2 and ready[1] == T1 and ready[2] == T2
+end 
+
+-- Timeout returns the ready subset only
+Step4 = function()
+	T3 = w1:DoSleep(1000)
+
+	local ready = LuaWorker.AwaitAll({T1, T3}, 100)
+
+	return #ready == 1 and ready[1] == T1
+end 
+
+-- Non-handles are ignored
+Step5 = function()
+	local ready = LuaWorker.AwaitAny({{}, 5, T1}, 100)
+
+	return #ready == 1 and ready[1] == T1
+end 
@@ -0,0 +1,86 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+w = LuaWorker.Create(100)
+w:Start()
+
+-- Least recently used entry is evicted
+Step1 = function()
+	local res = w:DoString([[
+		Squares = InLuaWorker.Cache(2)
+		Squares:Set(1, 1)
+		Squares:Set(2, 4)
+		Squares:Get(1)
+		Squares:Set(3, 9)
+		return tostring(Squares:Get(2)) .. "," .. Squares:Get(1) .. "," .. Squares:Get(3)
+	]]):Await(500)
+
+	RaiseFirstWorkerError(w)
+
+	return res == "nil,1,9"
+end 
+
+-- Value types are kept, nil removes
+Step2 = function()
+	local res = w:DoString([[
+		Squares:Set("k", false)
+		local wasFalse = Squares:Get("k") == false
+		Squares:Set("k", nil)
+		return tostring(wasFalse) .. tostring(Squares:Get("k")) .. tostring(Squares:Remove(3)) .. tostring(Squares:Remove(3))
+	]]):Await(500)
+
+	RaiseFirstWorkerError(w)
+
+	return res == "trueniltruefalse"
+end 
+
+-- Counters
+Step3 = function()
+	local res = w:DoString([[
+		local s = Squares:Stats()
+		return s.hits .. "," .. s.misses .. "," .. s.evictions .. "," .. s.size .. "," .. s.capacity
+	]]):Await(500)
+
+	RaiseFirstWorkerError(w)
+
+	return res == "4,2,2,0,2"
+end 
+
+-- Entries expire
+Step4 = function()
+	local res = w:DoString([[
+		local c = InLuaWorker.Cache(10, 100)
+		c:Set("a", "x")
+		local before = c:Get("a")
+		InLuaWorker.Sleep(200)
+		return tostring(before) .. tostring(c:Get("a")) .. c:Stats().expirations
+	]]):Await(1000)
+
+	RaiseFirstWorkerError(w)
+
+	return res == "xnil1"
+end 
+
+-- Tables cannot be stored
+Step5 = function()
+	local res = w:DoString("return tostring(pcall(Squares.Set, Squares, 1, {}))"):Await(500)
+
+	w:Stop()
+
+	return res == "false"
+end 
@@ -0,0 +1,105 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+w = LuaWorker.Create()
+w:Start()
+
+local yieldOnce = "function() InLuaWorker.YieldFor(1, 'y') return 'done' end"
+
+-- Queue coroutine tasks, and wait for them to finish
+local RunBatch = function(n)
+	local tasks = {}
+	for i = 1,n do
+		tasks[i] = w:DoCoroutine(yieldOnce)
+	end
+
+	for i = 1,n do
+		local polls = 0
+		while tasks[i]:Status() ~= LuaWorker.TaskStatus.Complete and polls < 500 do
+			tasks[i]:Await(10)
+			polls = polls + 1
+		end
+		if tasks[i]:Status() ~= LuaWorker.TaskStatus.Complete then return false end
+	end
+	return true
+end
+
+local CollectedBytes = function()
+	w:DoString("collectgarbage() collectgarbage()"):Await(1000)
+	return w:MemoryStats().BytesInUse
+end
+
+Step1 = function()
+	local ok = RunBatch(200)
+
+	BytesBefore = CollectedBytes()
+
+	RaiseFirstWorkerError(w)
+	return ok
+end 
+
+-- Finished threads are reused or released
+Step2 = function()
+	local ok = RunBatch(1000)
+
+	local bytesAfter = CollectedBytes()
+
+	RaiseFirstWorkerError(w)
+	return ok and bytesAfter < BytesBefore + 64 * 1024
+end 
+
+-- Suspended threads are kept from the collector while referenced only by the worker
+Step3 = function()
+	local tasks = {}
+	for i = 1,50 do
+		tasks[i] = w:DoCoroutine("function() local t = {'kept'} InLuaWorker.YieldFor(200) return t[1] end")
+	end
+
+	w:DoString("collectgarbage() collectgarbage()"):Await(1000)
+
+	for i = 1,50 do
+		if tasks[i]:Await(1000) ~= "kept" then return false end
+	end
+
+	RaiseFirstWorkerError(w)
+	return true
+end 
+
+-- A finished thread is taken from the free list by the next coroutine task
+Step4 = function()
+	local threadName = "function() InLuaWorker.YieldFor(1) return tostring(coroutine.running()) end"
+
+	local first = w:DoCoroutine(threadName):Await(1000)
+	local second = w:DoCoroutine(threadName):Await(1000)
+
+	RaiseFirstWorkerError(w)
+	return first ~= nil and first == second
+end 
+
+-- Globals replaced by a task are restored before its thread is reused
+Step5 = function()
+	w:DoString("Marker = 'm'"):Await(500)
+	w:DoCoroutine("function() setfenv(0, {}) return 'cleared' end"):Await(500)
+
+	local res = w:DoCoroutine("function() return tostring(Marker) end"):Await(500)
+
+	RaiseFirstWorkerError(w)
+	w:Stop()
+
+	return res == "m"
+end 
@@ -0,0 +1,70 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+Workers = {}
+for i = 1, 3 do
+	Workers[i] = LuaWorker.Create(100)
+	Workers[i]:Start()
+end
+
+Hits = LuaWorker.Counter("CountersTest", 4)
+
+-- Count from every worker
+Step1 = function()
+	local tasks = {}
+	for i, w in ipairs(Workers) do
+		tasks[i] = w:DoString([[
+			local hits = InLuaWorker.Counter("CountersTest")
+			for j = 1, 1000 do
+				hits:Add()
+				hits:Observe(j * ]] .. i .. [[)
+			end
+		]])
+	end
+	LuaWorker.AwaitAll(tasks, 1000)
+
+	for _, w in ipairs(Workers) do
+		RaiseFirstWorkerError(w)
+	end
+
+	local min, max, count = Hits:Range()
+
+	return Hits:Value() == 3000 and min == 1 and max == 3000 and count == 3000
+end 
+
+-- Fractional and negative amounts
+Step2 = function()
+	Hits:Add(0.5)
+	Hits:Add(-1)
+
+	return Hits:Value() == 2999.5
+end 
+
+-- Reset
+Step3 = function()
+	Hits:Reset()
+
+	local min, max, count = Hits:Range()
+
+	for _, w in ipairs(Workers) do
+		w:Stop()
+	end
+
+	return Hits:Value() == 0 and min == nil and max == nil and count == 0
+		and not pcall(Hits.Observe, Hits, "x")
+end 
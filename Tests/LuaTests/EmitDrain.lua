@@ -0,0 +1,76 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+initStr = [[
+StreamingFunc = function(n)
+	for i = 1,n do
+		InLuaWorker.Emit("row" .. i)
+		if i % 2 == 0 then InLuaWorker.YieldFor(100) end
+	end
+	return "done"
+end]]
+
+w = LuaWorker.Create()
+w:Start()
+
+Step1 = function()
+	w:DoString(initStr):Await(500)
+
+	RaiseFirstWorkerError(w)
+	
+	return w:Status() == LuaWorker.WorkerStatus.Processing
+end 
+
+Step2 = function()
+	T = w:DoString("for i = 1,5 do InLuaWorker.Emit('item' .. i) end return 'finished'")
+
+	local res = T:Await(500)
+
+	RaiseFirstWorkerError(w)
+	return res == "finished"
+end 
+
+Step3 = function()
+	local items = T:Drain()
+
+	if #items ~= 5 then error("Expected 5 items, got " .. #items) end
+
+	for i = 1,5 do
+		if items[i] ~= "item" .. i then error(items[i]) end
+	end
+
+	return #T:Drain() == 0
+end 
+
+Step4 = function()
+	T2 = w:DoCoroutine("StreamingFunc","6")
+
+	RaiseFirstWorkerError(w)
+	return true
+end 
+
+-- After ~0.5s: all rows emitted, none lost between yields
+Step5 = function()
+	local items = T2:Drain()
+
+	RaiseFirstWorkerError(w)
+	if #items ~= 6 then error("Expected 6 items, got " .. #items) end
+
+	return items[6] == "row6" and T2:Status() == LuaWorker.TaskStatus.Complete
+end 
+
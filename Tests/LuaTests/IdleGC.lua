@@ -0,0 +1,72 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+w = LuaWorker.Create(100, {IdleGC = true})
+w:Start()
+
+Step1 = function()
+	RaiseFirstWorkerError(w)
+
+	return w:Status() == LuaWorker.WorkerStatus.Processing
+end 
+
+-- Leave garbage behind
+Step2 = function()
+	local res = w:DoString("local keep = {} for i = 1,100000 do keep[i % 100 + 1] = {i} end return tostring(collectgarbage('count'))"):Await(1000)
+
+	KbAfterTask = tonumber(res)
+
+	return KbAfterTask ~= nil
+end 
+
+-- After ~0.5s idle
+Step3 = function()
+	local kb = tonumber(w:DoString("return tostring(collectgarbage('count'))"):Await(200))
+
+	return kb ~= nil and kb < KbAfterTask
+end 
+
+-- Collection does not hold up new tasks
+Step4 = function()
+	local res = w:DoString("return 'next'"):Await(200)
+
+	return res == "next"
+end 
+
+-- Leave garbage with a failing finalizer
+Step5 = function()
+	local res = w:DoString("local p = newproxy(true) getmetatable(p).__gc = function() error('in finalizer') end p = nil return 'left'"):Await(500)
+
+	return res == "left"
+end 
+
+-- After ~0.5s idle, the error is logged and the worker carries on
+Step6 = function()
+	local logged = false
+	local line = w:PopLogLine()
+	while line ~= nil do
+		logged = logged or line:find("Error in garbage collection", 1, true) ~= nil
+		line = w:PopLogLine()
+	end
+
+	local res = w:DoString("return 'next'"):Await(200)
+
+	w:Stop()
+
+	return logged and res == "next"
+end 
@@ -0,0 +1,69 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+w = LuaWorker.Create(100, {IdleTimeoutMillis = 200, IdleClose = true, Init = "Counter = 0"})
+_, Ready = w:Start()
+
+wKeep = LuaWorker.Create(100, {IdleTimeoutMillis = 200})
+_, ReadyKeep = wKeep:Start()
+
+Step1 = function()
+	LuaWorker.AwaitAll({Ready, ReadyKeep}, 1000)
+
+	local res = w:DoString("Counter = Counter + 1 return tostring(Counter)"):Await(500)
+	wKeep:DoString("Keep = 'kept' local p = newproxy(true) getmetatable(p).__gc = function() error('in finalizer') end"):Await(500)
+
+	RaiseFirstWorkerError(w)
+	RaiseFirstWorkerError(wKeep)
+
+	return res == "1"
+end 
+
+-- After ~0.5s idle the state is closed
+Step2 = function()
+	local stats = w:MemoryStats()
+
+	return stats.BytesInUse == 0 and stats.ArenaBytes == 0
+		and w:Status() == LuaWorker.WorkerStatus.Processing
+end 
+
+-- Reopened for the next task, with init run again
+Step3 = function()
+	local res = w:DoString("Counter = Counter + 1 return tostring(Counter)"):Await(1000)
+
+	RaiseFirstWorkerError(w)
+
+	return res == "1" and w:MemoryStats().BytesInUse > 0
+end 
+
+-- Without IdleClose, globals are kept. A failing finalizer is logged, and the worker carries on
+Step4 = function()
+	local res = wKeep:DoString("return Keep"):Await(500)
+
+	local logged = false
+	local line = wKeep:PopLogLine()
+	while line ~= nil do
+		logged = logged or line:find("Error in garbage collection", 1, true) ~= nil
+		line = wKeep:PopLogLine()
+	end
+
+	w:Stop()
+	wKeep:Stop()
+
+	return res == "kept" and logged
+end 
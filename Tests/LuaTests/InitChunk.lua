@@ -0,0 +1,59 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+w = LuaWorker.Create(100, {Preload = {"string", "table"}, Init = "Greeting = string.upper('hello') return 'ready'"})
+Status, Ready = w:Start()
+
+wBad = LuaWorker.Create(100, {Preload = {"no_such_module"}})
+StatusBad, ReadyBad = wBad:Start()
+
+-- Init runs before Processing
+Step1 = function()
+	local res = Ready:Await(1000)
+
+	RaiseFirstWorkerError(w)
+
+	return Status == LuaWorker.WorkerStatus.Starting
+		and res == "ready" 
+		and w:Status() == LuaWorker.WorkerStatus.Processing
+end 
+
+-- Globals from init are visible to tasks
+Step2 = function()
+	local res = w:DoString("return Greeting"):Await(500)
+
+	return res == "HELLO"
+end 
+
+-- Failed preload stops the worker
+Step3 = function()
+	ReadyBad:Await(1000)
+
+	return ReadyBad:Status() == LuaWorker.TaskStatus.Error 
+		and wBad:Status() == LuaWorker.WorkerStatus.Error
+end 
+
+-- Ready task is already complete on a later Start
+Step4 = function()
+	local status, ready = w:Start()
+
+	w:Stop()
+	wBad:Stop()
+
+	return status == LuaWorker.WorkerStatus.Processing and ready:Status() == LuaWorker.TaskStatus.Complete
+end 
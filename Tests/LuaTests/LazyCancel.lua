@@ -0,0 +1,99 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+initStr = [[
+LoopFunc = function()
+	InLuaWorker.YieldFor(1)
+	while true do math.abs(1) end
+end
+NestedLoopFunc = function()
+	InLuaWorker.YieldFor(1)
+	coroutine.wrap(function() while true do math.abs(1) end end)()
+end]]
+
+w = LuaWorker.Create(100, {CancelMode = LuaWorker.CancelMode.Lazy})
+w:Start()
+
+w2 = LuaWorker.Create(100, {CancelMode = LuaWorker.CancelMode.Lazy})
+w2:Start()
+
+Step1 = function()
+	w:DoString(initStr):Await(500)
+	w2:DoString(initStr):Await(500)
+
+	RaiseFirstWorkerError(w)
+	RaiseFirstWorkerError(w2)
+
+	return w:Status() == LuaWorker.WorkerStatus.Processing
+		and w2:Status() == LuaWorker.WorkerStatus.Processing
+end 
+
+-- Normal tasks unaffected by the missing hook
+Step2 = function()
+	local res = w:DoString("local n = 0 for i = 1,1000 do n = n + math.abs(-i) end return n"):Await(500)
+
+	RaiseFirstWorkerError(w)
+	return res == tostring(500500)
+end 
+
+-- Loop inside a coroutine the task resumes is interrupted by cancelling the task
+Step3 = function()
+	local t = w:DoString("local co = coroutine.create(function() while true do end end) while true do coroutine.resume(co) end")
+	t:Await(200)
+	if t:Status() ~= LuaWorker.TaskStatus.Running then return false end
+
+	t:Cancel()
+
+	local after = w:DoString("return 'after'"):Await(1000)
+
+	return after == "after" and t:Status() == LuaWorker.TaskStatus.Cancelled
+end 
+
+-- Resumed coroutine spins until cancelled
+Step4 = function()
+	T = w:DoCoroutine("LoopFunc")
+
+	T:Await(500)
+
+	return T:Status() == LuaWorker.TaskStatus.Running
+end 
+
+Step5 = function()
+	if T:Status() ~= LuaWorker.TaskStatus.Running then return false end
+
+	w:Stop()
+
+	return w:Status() == LuaWorker.WorkerStatus.Cancelled
+		and T:Status() == LuaWorker.TaskStatus.Error
+end 
+
+-- Loop inside a wrapped coroutine is interrupted by stopping the worker
+Step6 = function()
+	local t = w2:DoCoroutine("NestedLoopFunc")
+	t:Await(500)
+	if t:Status() ~= LuaWorker.TaskStatus.Running then return false end
+
+	w2:Stop()
+
+	return w2:Status() == LuaWorker.WorkerStatus.Cancelled
+		and t:Status() == LuaWorker.TaskStatus.Error
+end 
+
+Step7 = function()
+	return not pcall(LuaWorker.Create, 100, {CancelMode = 99})
+end 
@@ -0,0 +1,64 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+w = LuaWorker.Create(100, {Libs = {"string"}})
+_, Ready = w:Start()
+
+wAll = LuaWorker.Create(100)
+_, ReadyAll = wAll:Start()
+
+-- Fewer libraries, less memory
+Step1 = function()
+	LuaWorker.AwaitAll({Ready, ReadyAll}, 1000)
+
+	RaiseFirstWorkerError(w)
+
+	return w:Status() == LuaWorker.WorkerStatus.Processing
+		and w:MemoryStats().BytesInUse < wAll:MemoryStats().BytesInUse
+end 
+
+-- Only listed libraries are open
+Step2 = function()
+	local res = w:DoString("return tostring(rawget(_G, 'string') ~= nil) .. tostring(rawget(_G, 'math') == nil)"):Await(500)
+
+	return res == "truetrue"
+end 
+
+-- Others open on first access
+Step3 = function()
+	local res = w:DoString("return tostring(math.floor(2.5)) .. tostring(rawget(_G, 'math') ~= nil)"):Await(500)
+
+	return res == "2true"
+end 
+
+-- Or when required
+Step4 = function()
+	local res = w:DoString("local t = require('table') return tostring(t ~= nil and t == table)"):Await(500)
+
+	RaiseFirstWorkerError(w)
+
+	w:Stop()
+	wAll:Stop()
+
+	return res == "true"
+end 
+
+-- Unknown names are rejected
+Step5 = function()
+	return not pcall(LuaWorker.Create, 100, {Libs = {"nope"}})
+end 
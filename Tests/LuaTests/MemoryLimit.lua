@@ -0,0 +1,69 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+w = LuaWorker.Create(100, {MaxMemory = 2 * 1024 * 1024})
+w:Start()
+
+Step1 = function()
+	RaiseFirstWorkerError(w)
+
+	return w:Status() == LuaWorker.WorkerStatus.Processing
+		and w:MemoryStats().MaxMemory == 2 * 1024 * 1024
+end 
+
+-- Worker ceiling fails the task, not the worker (task errors are logged, so worker log not checked from here)
+Step2 = function()
+	local t = w:DoString("local s = string.rep('x', 4 * 1024 * 1024) return 'big'")
+	t:Await(1000)
+
+	local stats = w:MemoryStats()
+
+	return t:Status() == LuaWorker.TaskStatus.Error
+		and stats.FailedAllocations > 0
+		and stats.PeakBytesInUse <= stats.MaxMemory
+		and w:DoString("return 'next'"):Await(500) == "next"
+end 
+
+-- Per-task limits
+Step3 = function()
+	local code = "local t = {} for i = 1,1000 do t[i] = {i} end return 'done'"
+	local t1 = w:DoString(code, {MaxMemory = 1000})
+	local t2 = w:DoString(code, {MaxMemory = 1024 * 1024})
+
+	LuaWorker.AwaitAll({t1, t2}, 1000)
+
+	return t1:Status() == LuaWorker.TaskStatus.Error 
+		and t2:Await(0) == "done"
+end 
+
+-- Out of memory errors can be caught
+Step4 = function()
+	local res = w:DoString("local ok = pcall(string.rep, 'x', 1024 * 1024) return ok and 'allocated' or 'refused'", {MaxMemory = 1000}):Await(500)
+
+	return res == "refused"
+end 
+
+-- Garbage is collected before a task limit fails on it, even with much live data delaying lua's own collection
+Step5 = function()
+	w:DoString("Retained = {} for i = 1,20000 do Retained[i] = i end"):Await(1000)
+
+	local res = w:DoString("local n = 0 for i = 1,20000 do local t = {i} n = n + #t end return n", {MaxMemory = 64 * 1024}):Await(2000)
+
+	RaiseFirstWorkerError(w)
+	return res == tostring(20000)
+end
@@ -0,0 +1,67 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+w = LuaWorker.Create(100)
+w2 = LuaWorker.Create(100, {PoolAllocator = false})
+
+-- Nothing allocated before start
+Step1 = function()
+	local stats = w:MemoryStats()
+
+	w:Start()
+	w2:Start()
+
+	return stats.BytesInUse == 0 and stats.Allocations == 0
+end 
+
+Step2 = function()
+	local res = w:DoString("local t = {} for i = 1,1000 do t[i] = {i} end return #t"):Await(500)
+
+	RaiseFirstWorkerError(w)
+
+	local stats = w:MemoryStats()
+
+	return res == "1000" 
+		and stats.BytesInUse > 0 
+		and stats.PeakBytesInUse >= stats.BytesInUse
+		and stats.PooledAllocations > 0 
+		and stats.PooledAllocations <= stats.Allocations
+		and stats.ArenaBytes > 0
+end 
+
+-- System allocator keeps stats only
+Step3 = function()
+	local res = w2:DoString("local t = {} for i = 1,1000 do t[i] = {i} end return #t"):Await(500)
+
+	RaiseFirstWorkerError(w2)
+
+	local stats = w2:MemoryStats()
+
+	return res == "1000" 
+		and stats.BytesInUse > 0 
+		and stats.Allocations > 0 
+		and stats.PooledAllocations == 0 
+		and stats.ArenaBytes == 0
+end 
+
+Step4 = function()
+	w:Stop()
+	w2:Stop()
+
+	return w:MemoryStats().BytesInUse == 0
+end 
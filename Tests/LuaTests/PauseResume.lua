@@ -0,0 +1,50 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+w = LuaWorker.Create()
+_, Ready = w:Start()
+
+Step1 = function()
+	Ready:Await(1000)
+	w:DoString("Warm = 'kept'"):Await(500)
+
+	RaiseFirstWorkerError(w)
+
+	return w:Pause() == LuaWorker.WorkerStatus.Paused
+end 
+
+-- Tasks wait while paused
+Step2 = function()
+	T = w:DoString("return Warm")
+
+	return T:Await(300) == nil and T:Status() == LuaWorker.TaskStatus.NotStarted
+end 
+
+-- The same lua state carries on after resuming
+Step3 = function()
+	local status = w:Resume()
+
+	return status == LuaWorker.WorkerStatus.Processing and T:Await(500) == "kept"
+end 
+
+-- Stop while paused
+Step4 = function()
+	w:Pause()
+
+	return w:Stop() == LuaWorker.WorkerStatus.Cancelled and w:Resume() == LuaWorker.WorkerStatus.Cancelled
+end 
@@ -0,0 +1,97 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+initStr = [[
+TwoStepFunc = function()
+	InLuaWorker.YieldFor(100)
+	return "second"
+end]]
+
+w = LuaWorker.Create()
+w:Start()
+
+-- Tasks added before the first poll are not tracked
+Step1 = function()
+	w:DoString(initStr):Await(500)
+
+	RaiseFirstWorkerError(w)
+	
+	return w:Status() == LuaWorker.WorkerStatus.Processing and #w:PollCompleted() == 0
+end 
+
+-- Completed tasks returned once each, oldest first, same handles
+Step2 = function()
+	T1 = w:DoString("return 'one'")
+	T2 = w:DoString("return 'two'")
+	T3 = w:DoString("error('three')")
+
+	T3:Await(500)
+
+	local first = w:PollCompleted(2)
+	local rest = w:PollCompleted(10)
+
+	RaiseFirstWorkerError(w)
+	return #first == 2 and first[1] == T1 and first[2] == T2
+		and #rest == 1 and rest[1] == T3
+		and #w:PollCompleted(10) == 0
+end 
+
+Step3 = function()
+	T4 = w:DoCoroutine("TwoStepFunc")
+
+	RaiseFirstWorkerError(w)
+	return true
+end 
+
+-- After ~0.3s: two results, but queued once until polled
+Step4 = function()
+	local ready = w:PollCompleted()
+
+	RaiseFirstWorkerError(w)
+	return #ready == 1 and ready[1] == T4 and T4:Await(0) == "second"
+end 
+
+-- OS handle available and stable
+Step5 = function()
+	local h = w:CompletionHandle()
+
+	return h ~= nil and h == w:CompletionHandle()
+end 
+
+-- A worker which is never polled holds no finished tasks
+Step6 = function()
+	local wUnpolled = LuaWorker.Create()
+	wUnpolled:Start()
+
+	local last
+	for i = 1, 500 do
+		last = wUnpolled:DoString("return string.rep('x', 10000)")
+	end
+	last:Await(2000)
+
+	local held = #wUnpolled:PollCompleted()
+
+	local polledTask = wUnpolled:DoString("return 'polled'")
+	polledTask:Await(500)
+	local ready = wUnpolled:PollCompleted()
+
+	RaiseFirstWorkerError(wUnpolled)
+	wUnpolled:Stop()
+
+	return held == 0 and #ready == 1 and ready[1] == polledTask
+end 
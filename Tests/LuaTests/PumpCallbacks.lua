@@ -0,0 +1,85 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+initStr = [[
+ProgressFunc = function()
+	InLuaWorker.YieldFor(200, "half")
+	return "all"
+end]]
+
+w = LuaWorker.Create()
+w:Start()
+
+Completed = {}
+Progress = {}
+
+Step1 = function()
+	w:DoString(initStr):Await(500)
+
+	RaiseFirstWorkerError(w)
+	
+	return w:Status() == LuaWorker.WorkerStatus.Processing
+end 
+
+Step2 = function()
+	-- Handles not kept by the caller
+	w:DoString("return 'a'"):OnComplete(function(res) Completed[#Completed + 1] = res end)
+	w:DoString("error('b')"):OnComplete(function(res, task) 
+		Completed[#Completed + 1] = tostring(res) .. task:Status() 
+	end)
+	T = w:DoCoroutine("ProgressFunc")
+		:OnYield(function(res) Progress[#Progress + 1] = res end)
+		:OnComplete(function(res) Completed[#Completed + 1] = res end)
+
+	RaiseFirstWorkerError(w)
+	return true
+end 
+
+-- After ~0.1s: nothing run until pumped
+Step3 = function()
+	collectgarbage()
+	if #Completed ~= 0 or #Progress ~= 0 then return false end
+
+	local pending = LuaWorker.Pump(10)
+
+	RaiseFirstWorkerError(w)
+	return pending == 0 and #Completed == 2 
+		and Completed[1] == "a" and Completed[2] == "nil" .. LuaWorker.TaskStatus.Error
+		and #Progress == 1 and Progress[1] == "half"
+end 
+
+-- After ~0.4s: completion of coroutine
+Step4 = function()
+	LuaWorker.Pump(10)
+
+	return #Completed == 3 and Completed[3] == "all"
+end 
+
+-- Callback errors raised from Pump, remaining dispatch carried over
+Step5 = function()
+	local t1 = w:DoString("return 1"):OnComplete(function() error("fail") end)
+	local t2 = w:DoString("return 2"):OnComplete(function(res) Completed[#Completed + 1] = res end)
+
+	LuaWorker.AwaitAll({t1, t2}, 500)
+
+	local ok = pcall(LuaWorker.Pump, 10)
+	if ok then return false end
+
+	LuaWorker.Pump(10)
+	return #Completed == 4 and Completed[4] == "2"
+end 
@@ -0,0 +1,46 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+-- Loaded into two host states, which each pump only their own callbacks
+
+w = LuaWorker.Create()
+w:Start()
+
+-- Register a callback in this state on a task which completes at once
+Register = function()
+	Fired = nil
+	local t = w:DoString("return 'mine'")
+	t:OnComplete(function(result) Fired = result end)
+	t:Await(500)
+
+	RaiseFirstWorkerError(w)
+	return true
+end
+
+-- Pump with nothing of this state's to dispatch
+PumpOther = function()
+	return LuaWorker.Pump(100) == 0 and Fired == nil
+end
+
+-- Callback registered in this state still fires here
+PumpOwn = function()
+	LuaWorker.Pump(100)
+
+	w:Stop()
+	return Fired == "mine"
+end
@@ -0,0 +1,54 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+w = LuaWorker.Create(100, {RecycleAfterTasks = 3, Init = "StateId = tostring({})"})
+_, Ready = w:Start()
+
+local task = "Count = (Count or 0) + 1 return StateId .. ',' .. Count"
+
+Step1 = function()
+	Ready:Await(1000)
+
+	Results = {}
+	for i = 1,3 do
+		Results[i] = w:DoString(task):Await(500)
+	end
+
+	RaiseFirstWorkerError(w)
+
+	return Results[1] ~= nil and Results[1] ~= Results[2] and Results[3] ~= nil
+end 
+
+-- After ~0.5s, a fresh state with the init run
+Step2 = function()
+	local first = string.match(Results[1], "(.*),")
+	local res = w:DoString(task):Await(500)
+
+	return res ~= nil and string.match(res, "(.*),") ~= first and string.match(res, ",(.*)") == "1"
+end 
+
+Step3 = function()
+	local recycled = false
+	local line = w:PopLogLine()
+	while line ~= nil do
+		recycled = recycled or line:find("Lua state recycled.", 1, true) ~= nil
+		line = w:PopLogLine()
+	end
+
+	return recycled and w:Stop() == LuaWorker.WorkerStatus.Cancelled
+end 
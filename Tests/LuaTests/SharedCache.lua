@@ -0,0 +1,85 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+w1 = LuaWorker.Create(100)
+w1:Start()
+
+w2 = LuaWorker.Create(100)
+w2:Start()
+
+Shared = LuaWorker.SharedCache("SharedCacheTest", 4096, 4)
+
+-- Values set in one worker are read by another
+Step1 = function()
+	w1:DoString([[
+		InLuaWorker.SharedCache("SharedCacheTest"):Set("k", {a = 1, b = {"x"}})
+	]]):Await(500)
+
+	local res = w2:DoString([[
+		local v = InLuaWorker.SharedCache("SharedCacheTest"):Get("k")
+		return v.b[1] .. v.a
+	]]):Await(500)
+
+	RaiseFirstWorkerError(w1)
+	RaiseFirstWorkerError(w2)
+
+	return res == "x1" and Shared:Get("k").a == 1
+end 
+
+-- Values are copies
+Step2 = function()
+	local v = Shared:Get("k")
+	v.a = 2
+
+	return Shared:Get("k").a == 1
+end 
+
+-- Byte budget is kept by eviction
+Step3 = function()
+	for i = 1, 200 do
+		Shared:Set(i, string.rep("v", 20))
+	end
+
+	local stats = Shared:Stats()
+
+	return stats.evictions > 0 and stats.bytes <= stats.capacity and #stats.shards == 4
+		and Shared:Get(200) ~= nil
+end 
+
+-- Oversized values are not stored, nil removes
+Step4 = function()
+	local stored = Shared:Set("big", string.rep("v", 2000))
+	Shared:Set(200, nil)
+
+	return stored == false and Shared:Get("big") == nil and Shared:Get(200) == nil
+end 
+
+-- Lock counters
+Step5 = function()
+	local stats = Shared:Stats()
+	local locks = 0
+	for _, shard in ipairs(stats.shards) do
+		locks = locks + shard.locks
+	end
+
+	w1:Stop()
+	w2:Stop()
+
+	return locks == stats.locks and stats.locks > 200
+		and not pcall(Shared.Set, Shared, "f", print)
+end 
@@ -0,0 +1,79 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+w = LuaWorker.Create(100)
+w:Start()
+
+Config = LuaWorker.Snapshot("SnapshotTest")
+
+ReadConfig = [[
+	local config, version = InLuaWorker.Snapshot("SnapshotTest"):Get()
+	return tostring(config and config.level) .. "," .. version
+]]
+
+-- Nothing published yet
+Step1 = function()
+	local res = w:DoString(ReadConfig):Await(500)
+
+	RaiseFirstWorkerError(w)
+
+	return res == "nil,0" and Config:Version() == 0
+end 
+
+-- Workers see the published version
+Step2 = function()
+	local version = Config:Publish({level = 1, names = {"a", "b"}})
+
+	local res = w:DoString(ReadConfig):Await(500)
+
+	RaiseFirstWorkerError(w)
+
+	return version == 1 and res == "1,1"
+end 
+
+-- Each read is a private copy, so changing one does not affect later reads
+Step3 = function()
+	local a = Config:Get()
+	a.level = 99
+	a.names[2] = "changed"
+
+	local b, version = Config:Get()
+
+	return not rawequal(a, b) and version == 1 and b.level == 1 and b.names[2] == "b"
+end 
+
+-- Each publish replaces the value
+Step4 = function()
+	local old = Config:Get()
+	Config:Publish({level = 2})
+
+	local res = w:DoString(ReadConfig):Await(500)
+
+	RaiseFirstWorkerError(w)
+
+	local new, version = Config:Get()
+
+	return res == "2,2" and version == 2 and new.level == 2 and old.level == 1
+end 
+
+-- Functions cannot be published
+Step5 = function()
+	w:Stop()
+
+	return not pcall(Config.Publish, Config, print) and Config:Version() == 2
+end 
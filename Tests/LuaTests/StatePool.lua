@@ -0,0 +1,77 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+Step1 = function()
+	LuaWorker.SetStatePoolSize(2)
+
+	return true
+end 
+
+-- After ~0.5s, states are parked
+Step2 = function()
+	if LuaWorker.SetStatePoolSize(2) ~= 2 then return false end
+
+	w = LuaWorker.Create()
+	w:Start()
+
+	return w:DoString("return 'pooled'"):Await(500) == "pooled"
+end 
+
+-- Pooled state was used, and reports to this worker's log
+Step3 = function()
+	local adopted = false
+
+	while true do
+		local line = w:PopLogLine()
+		if line == nil then break end
+		if string.find(line, "Adopted lua state from pool", 1, true) then adopted = true end
+	end
+
+	local res = w:DoString("InLuaWorker.LogInfo('from lua') return 'logged'"):Await(500)
+
+	return adopted and res == "logged" and string.find(w:PopLogLine() or "", "from lua", 1, true) ~= nil
+end 
+
+-- Workers with other options start their own thread
+Step4 = function()
+	w2 = LuaWorker.Create(100, {IdleGC = true})
+	w2:Start()
+
+	local res = w2:DoString("return 'own'"):Await(500)
+
+	local adopted = false
+	while true do
+		local line = w2:PopLogLine()
+		if line == nil then break end
+		if string.find(line, "Adopted lua state from pool", 1, true) then adopted = true end
+	end
+
+	w:Stop()
+	w2:Stop()
+
+	return res == "own" and not adopted and w:Status() == LuaWorker.WorkerStatus.Cancelled
+end 
+
+-- After ~0.5s, the pool is topped up again
+Step5 = function()
+	local parked = LuaWorker.SetStatePoolSize(2)
+
+	LuaWorker.SetStatePoolSize(0)
+
+	return parked == 2
+end 
@@ -0,0 +1,87 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+initStr = [[
+SumChunks = function()
+	local total = 0
+	local count = 0
+	while true do
+		local chunk = InLuaWorker.Read()
+		if chunk == nil then break end
+		for n in string.gmatch(chunk, "%d+") do total = total + tonumber(n) end
+		count = count + 1
+	end
+	return count .. ":" .. total
+end]]
+
+w = LuaWorker.Create()
+w:Start()
+
+Step1 = function()
+	w:DoString(initStr):Await(500)
+
+	RaiseFirstWorkerError(w)
+	
+	return w:Status() == LuaWorker.WorkerStatus.Processing
+end 
+
+-- Coroutine waits for input
+Step2 = function()
+	T = w:DoCoroutine("SumChunks")
+
+	local res = T:Await(200)
+
+	RaiseFirstWorkerError(w)
+	return res == nil and T:Status() == LuaWorker.TaskStatus.Suspended
+end 
+
+Step3 = function()
+	local ok = T:Write("1 2 3", 100)
+	ok = ok and T:Write("10 20", 100)
+	ok = ok and T:Write("100", 100)
+
+	RaiseFirstWorkerError(w)
+	return ok
+end 
+
+Step4 = function()
+	T:CloseInput()
+
+	local res = T:Await(500)
+
+	RaiseFirstWorkerError(w)
+	if res ~= "3:136" then error(res) end
+
+	return T:Status() == LuaWorker.TaskStatus.Complete
+end 
+
+Step5 = function()
+	return T:Write("1", 100) == false
+end 
+
+-- Buffer is bounded when the coroutine does not read
+Step6 = function()
+	T2 = w:DoCoroutine("function() InLuaWorker.YieldFor(1000) return 'x' end")
+
+	for i = 1,16 do
+		if not T2:Write("chunk", 0) then error("Write " .. i .. " failed") end
+	end
+
+	RaiseFirstWorkerError(w)
+	return T2:Write("chunk", 100) == false
+end 
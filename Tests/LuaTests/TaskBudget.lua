@@ -0,0 +1,89 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+initStr = [[
+BusyFunc = function()
+	for i = 1,20 do
+		local t0 = os.clock()
+		while os.clock() - t0 < 0.02 do end
+		InLuaWorker.YieldFor(1)
+	end
+	return "done"
+end]]
+
+w = LuaWorker.Create()
+w:Start()
+
+Step1 = function()
+	w:DoString(initStr):Await(500)
+
+	RaiseFirstWorkerError(w)
+	
+	return w:Status() == LuaWorker.WorkerStatus.Processing
+end 
+
+-- Runaway task fails alone (task errors are logged, so worker log not checked from here)
+Step2 = function()
+	local t = w:DoString("while true do end", {MaxMillis = 100})
+	t:Await(1000)
+
+	return t:Status() == LuaWorker.TaskStatus.Error
+		and w:Status() == LuaWorker.WorkerStatus.Processing
+		and w:DoString("return 'next'"):Await(500) == "next"
+end 
+
+-- Instruction limits
+Step3 = function()
+	local code = "local n = 0 for i = 1,100000 do n = n + 1 end return 'done'"
+	local t1 = w:DoString(code, {MaxInstructions = 1000})
+	local t2 = w:DoString(code, {MaxInstructions = 1e8})
+
+	LuaWorker.AwaitAll({t1, t2}, 1000)
+
+	return t1:Status() == LuaWorker.TaskStatus.Error 
+		and t2:Await(0) == "done"
+end 
+
+-- Budget error can't be swallowed by pcall
+Step4 = function()
+	local t = w:DoString("while true do pcall(function() while true do end end) end", {MaxMillis = 50})
+	t:Await(1000)
+
+	return t:Status() == LuaWorker.TaskStatus.Error
+end 
+
+-- Coroutine budget summed over resumes. Each resume runs ~20ms, within the limit on its own
+Step5 = function()
+	while w:PopLogLine() ~= nil do end -- Discard errors logged by earlier steps
+
+	T = w:DoCoroutine("BusyFunc", {MaxMillis = 100})
+
+	return true
+end 
+
+-- After ~0.5s
+Step6 = function()
+	local exceeded = false
+	local line = w:PopLogLine()
+	while line ~= nil do
+		exceeded = exceeded or line:find("Task budget exceeded.", 1, true) ~= nil
+		line = w:PopLogLine()
+	end
+
+	return T:Status() == LuaWorker.TaskStatus.Error and exceeded
+end 
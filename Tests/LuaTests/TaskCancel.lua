@@ -0,0 +1,93 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+initStr = [[
+TickFunc = function()
+	while true do
+		InLuaWorker.Emit("tick")
+		InLuaWorker.YieldFor(50)
+	end
+end]]
+
+w = LuaWorker.Create()
+w:Start()
+
+wLazy = LuaWorker.Create(100, {CancelMode = LuaWorker.CancelMode.Lazy})
+wLazy:Start()
+
+Step1 = function()
+	w:DoString(initStr):Await(500)
+
+	RaiseFirstWorkerError(w)
+	
+	return w:Status() == LuaWorker.WorkerStatus.Processing
+end 
+
+-- Queued task removed
+Step2 = function()
+	local sleep = w:DoSleep(200)
+	local t = w:DoString("Ran = true return 'x'")
+	t:Cancel()
+
+	local after = w:DoString("return tostring(Ran)"):Await(1000)
+
+	RaiseFirstWorkerError(w)
+	return t:Status() == LuaWorker.TaskStatus.Cancelled 
+		and sleep:Status() == LuaWorker.TaskStatus.Complete
+		and after == "nil"
+end 
+
+-- Running task interrupted, pcall can't catch it
+Step3 = function()
+	local t = w:DoString("while true do pcall(function() while true do end end) end")
+	t:Await(200)
+	if t:Status() ~= LuaWorker.TaskStatus.Running then return false end
+
+	t:Cancel()
+
+	local after = w:DoString("return 'after'"):Await(1000)
+
+	return after == "after" and t:Status() == LuaWorker.TaskStatus.Cancelled
+		and w:Status() == LuaWorker.WorkerStatus.Processing
+end 
+
+-- Suspended coroutine not resumed again
+Step4 = function()
+	T = w:DoCoroutine("TickFunc")
+	T:Await(500)
+	T:Cancel()
+	T:Drain()
+
+	return T:Status() == LuaWorker.TaskStatus.Cancelled
+end 
+
+-- After ~0.3s
+Step5 = function()
+	return #T:Drain() == 0
+end 
+
+-- Running task interrupted in lazy mode
+Step6 = function()
+	local t = wLazy:DoString("while true do end")
+	t:Await(200)
+	t:Cancel()
+
+	local after = wLazy:DoString("return 'after'"):Await(1000)
+
+	return after == "after" and t:Status() == LuaWorker.TaskStatus.Cancelled
+end 
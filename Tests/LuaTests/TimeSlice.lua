@@ -0,0 +1,91 @@
+--[[*****************************************************************************
+* 
+*  Copyright 2023 HappyGnome
+*  
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*  
+*  http ://www.apache.org/licenses/LICENSE-2.0
+*  
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+* 
+]]--*****************************************************************************
+
+initStr = [[
+SpinFunc = function()
+	while not StopSpin do end
+	return "stopped"
+end
+
+NestedSpinFunc = function()
+	local spin = function() 
+		while not StopNestedSpin do end
+	end
+	spin()
+	return "stopped"
+end
+
+PcallSpinFunc = function()
+	pcall(function() while true do end end)
+end
+
+SlowArgFunc = function()
+	local t0 = os.clock()
+	while os.clock() - t0 < 0.05 do end
+	return ArgFunc
+end
+
+ArgFunc = function()
+	return "started"
+end]]
+
+w = LuaWorker.Create(100, {TimeSliceMillis = 20})
+w:Start()
+
+Step1 = function()
+	w:DoString(initStr):Await(500)
+
+	RaiseFirstWorkerError(w)
+
+	T = w:DoCoroutine("SpinFunc")
+	T2 = w:DoCoroutine("NestedSpinFunc")
+
+	return w:Status() == LuaWorker.WorkerStatus.Processing
+end 
+
+-- New tasks run between slices of the spinning coroutines
+Step2 = function()
+	local res = w:DoString("StopSpin = true return 'ok'"):Await(500)
+
+	return res == "ok" and T:Await(500) == "stopped"
+end 
+
+-- Preempted in a nested call, without yielding a result
+Step3 = function()
+	local res = w:DoString("StopNestedSpin = true return 'ok'"):Await(500)
+
+	return res == "ok" and T2:Await(500) == "stopped"
+end 
+
+-- Not preempted while the function is evaluated, before the coroutine starts
+Step4 = function()
+	local res = w:DoCoroutine("SlowArgFunc()"):Await(500)
+
+	RaiseFirstWorkerError(w)
+	return res == "started"
+end 
+
+-- Not preempted inside pcall
+Step5 = function()
+	T3 = w:DoCoroutine("PcallSpinFunc")
+	local res = w:DoString("return 'ok'"):Await(200)
+
+	w:Stop()
+
+	return res == nil and T3:Status() == LuaWorker.TaskStatus.Error
+end 